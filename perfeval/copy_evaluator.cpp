@@ -0,0 +1,121 @@
+/*
+ * copy_evaluator.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Sweeps the runtime's copy kernels (see runtime/unit/copy.h) over value
+// sizes, to find where non-temporal copies start to pay off. Besides the copy
+// itself, it measures the time to re-read a hot working set (standing in for
+// unit headers and parser constants) after each copy, which copies through
+// the caches slow down by evicting it.
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <chrono>  // NOLINT
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "runtime/unit/copy.h"
+#include "util/util.h"
+
+namespace dr = diffingo::runtime;
+
+namespace {
+
+const size_t kHotSetSize = 256 * 1024;
+const size_t kBytesPerRun = 1024 * 1024 * 1024;
+
+typedef void (*CopyKernel)(char* dest, const char* src, size_t len);
+
+void copyMemcpy(char* dest, const char* src, size_t len) {
+  memcpy(dest, src, len);
+}
+
+void copyVector(char* dest, const char* src, size_t len) {
+  dr::unit::detail::copyVector(dest, src, len);
+}
+
+void copyNonTemporal(char* dest, const char* src, size_t len) {
+  dr::unit::detail::copyNonTemporal(dest, src, len);
+}
+
+void copyMemory(char* dest, const char* src, size_t len) {
+  dr::unit::copyMemory(dest, src, len);
+}
+
+// returns the duration of num_repeats copies in ns, optionally re-reading
+// the hot set after each copy
+int64_t measure(CopyKernel kernel, char* dest, const char* src, size_t len,
+                size_t num_repeats, const std::vector<char>& hot,
+                bool read_hot, volatile char* sink) {
+  auto begin = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < num_repeats; i++) {
+    kernel(dest, src, len);
+    // keep the compiler from merging or dropping the repeated copies
+    asm volatile("" : : "r"(dest) : "memory");
+    if (read_hot) {
+      char sum = 0;
+      for (size_t j = 0; j < hot.size(); j += 64) sum ^= hot[j];
+      *sink = sum;
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+      .count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t bytes_per_run = kBytesPerRun;
+  if (argc > 1) bytes_per_run = strtoull(argv[1], nullptr, 10);
+
+  const std::vector<std::pair<std::string, CopyKernel>> kernels = {
+      {"memcpy", copyMemcpy},
+      {"vector", copyVector},
+      {"non_temporal", copyNonTemporal},
+      {"copy_memory", copyMemory}};
+
+  size_t max_len = 64 * 1024 * 1024;
+  std::vector<char> src(max_len, 1), dest(max_len, 0), hot(kHotSetSize, 2);
+  volatile char sink;
+
+  std::cout << util::fmt("%s;%s;%s;%s;%s", "kernel", "value_len",
+                         "num_repeats", "copy_duration_ns",
+                         "copy_hot_read_duration_ns") << std::endl;
+  for (size_t len = 64; len <= max_len; len *= 4) {
+    size_t num_repeats = bytes_per_run / len;
+    if (num_repeats == 0) num_repeats = 1;
+    for (const auto& k : kernels) {
+      auto copy_ns = measure(k.second, &dest[0], &src[0], len, num_repeats,
+                             hot, false, &sink);
+      auto copy_hot_ns = measure(k.second, &dest[0], &src[0], len,
+                                 num_repeats, hot, true, &sink);
+      std::cout << util::fmt("%s;%d;%d;%d;%d", k.first, len, num_repeats,
+                             copy_ns, copy_hot_ns) << std::endl;
+    }
+  }
+}
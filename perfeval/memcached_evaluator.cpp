@@ -39,10 +39,12 @@
 
 #include "examples/out_test/memcached.h"
 #include "examples/out_test/memcached_inst.h"
+#include "runtime/parsing/parse_context.h"
 #include "runtime/parsing/parse_result.h"
 #include "runtime/parsing/parser_state.h"
 #include "runtime/runtime.h"
 #include "runtime/serializing/serialize_result.h"
+#include "runtime/unit/buffer_pool.h"
 #include "runtime/unit/data_type.h"
 #include "runtime/unit/unit_area.h"
 #include "util/util.h"
@@ -143,10 +145,35 @@ inline void MemcachedEvaluator::runExperiments() {
     ASSERT_EQ(dr::serializing::SerializeResult::DONE, sres);
     ASSERT_EQ(in_buf_end_ - in_buf_, bytes_written);
 
+    /* ---- RUN BATCH SERIALIZING ---- */
+    // multi-get bursts: the same number of responses, kBatchSize at a time
+    char* units[kBatchSize];
+    for (size_t i = 0; i < kBatchSize; i++) units[i] = area_->contents();
+    size_t units_written;
+    begin = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < num_repeats_ / kBatchSize; i++) {
+      state_->reset();
+      sres = serializer.serializeBatch(units, kBatchSize, ser_buf_,
+                                       ser_buf_end, state_, &bytes_written,
+                                       &units_written);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    auto batch_serializing_duration_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+            .count();
+
+    pantheios::log(pantheios::informational,
+                   util::fmt("Serializing (batched) done in %d ns.",
+                             batch_serializing_duration_ns));
+
+    ASSERT_EQ(dr::serializing::SerializeResult::DONE, sres);
+    ASSERT_EQ(static_cast<size_t>(kBatchSize), units_written);
+    ASSERT_EQ(kBatchSize * (in_buf_end_ - in_buf_), bytes_written);
+
     Result result(util::type_name<Parser>(), key_len_, extras_len_, value_len_,
                   num_repeats_, bytes_read, msg_size_parsed,
                   parsing_duration_ns, parsing_incr_duration_ns,
-                  serializing_duration_ns);
+                  serializing_duration_ns, batch_serializing_duration_ns);
     result_records_.push_back(result);
   }
 }
@@ -239,7 +266,7 @@ void MemcachedEvaluator::runLibmemcachedExperiments() {
 
     Result result("libmemcached", key_len_, extras_len_, value_len_,
                   num_repeats_, bytes_read, -1, parsing_duration_ns,
-                  parsing_incr_duration_ns, serializing_duration_ns);
+                  parsing_incr_duration_ns, serializing_duration_ns, -1);
     result_records_.push_back(result);
   }
 
@@ -247,14 +274,16 @@ void MemcachedEvaluator::runLibmemcachedExperiments() {
 }
 
 void MemcachedEvaluator::run() {
-  char* stack_buf = reinterpret_cast<char*>(malloc(kStackBufSize));
-  char* out_buf = reinterpret_cast<char*>(malloc(kOutBufSize));
   in_buf_ = reinterpret_cast<char*>(malloc(kInBufSize));
   ser_buf_ = reinterpret_cast<char*>(malloc(kSerBufSize));
 
-  area_ = new (out_buf) dr::unit::UnitArea(kOutBufSize);
-  dr::parsing::ParserState state(stack_buf, kStackBufSize);
-  state_ = &state;
+  // area and parser stack are pooled, as they would be in a server
+  dr::unit::BufferPool area_pool(kOutBufSize, 1);
+  dr::unit::BufferPool stack_pool(kStackBufSize, 1);
+  dr::parsing::ParseContext context(&area_pool, &stack_pool);
+  ASSERT_TRUE(context.acquire());
+  area_ = context.area();
+  state_ = context.state();
 
   key_len_ = 35;
   extras_len_ = 16;
@@ -364,17 +393,26 @@ void MemcachedEvaluator::fillInputBuffer() {
 }
 
 void MemcachedEvaluator::printResults() {
-  std::cout << util::fmt("%s;%s;%s;%s;%s;%s;%s;%s;%s;%s;%s", "parser",
+  std::cout << util::fmt("%s;%s;%s;%s;%s;%s;%s;%s;%s;%s;%s;%s;%s", "parser",
                          "key_len", "extras_len", "value_len",
                          "num_experiments", "num_repeats", "msg_size_wire",
                          "msg_size_parsed", "parsing_duration_ns",
-                         "parsing_incr_duration_ns", "serializing_duration_ns")
-            << std::endl;
+                         "parsing_incr_duration_ns", "serializing_duration_ns",
+                         "batch_serializing_duration_ns",
+                         "batch_responses_per_s") << std::endl;
   for (const auto& r : result_records_) {
-    std::cout << util::fmt("%s;%d;%d;%d;%d;%d;%d;%d;%d;%d", r.parser_,
+    int64_t responses_per_s = -1;
+    if (r.batch_serializing_duration_ns_ > 0) {
+      size_t responses = r.num_repeats_ / kBatchSize * kBatchSize;
+      responses_per_s = static_cast<int64_t>(
+          responses * 1e9 / r.batch_serializing_duration_ns_);
+    }
+    std::cout << util::fmt("%s;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d;%d", r.parser_,
                            r.key_len_, r.extras_len_, r.value_len_,
                            r.num_repeats_, r.msg_size_wire_, r.msg_size_parsed_,
                            r.parsing_duration_ns_, r.parsing_incr_duration_ns_,
-                           r.serializing_duration_ns_) << std::endl;
+                           r.serializing_duration_ns_,
+                           r.batch_serializing_duration_ns_, responses_per_s)
+              << std::endl;
   }
 }
@@ -53,11 +53,13 @@ class MemcachedEvaluator {
     int64_t parsing_duration_ns_;
     int64_t parsing_incr_duration_ns_;
     int64_t serializing_duration_ns_;
+    int64_t batch_serializing_duration_ns_;
 
     Result(std::string parser, size_t key_len, size_t extras_len,
            size_t value_len, size_t num_repeats, size_t msg_size_wire,
            size_t msg_size_parsed, int64_t parsing_duration_ns,
-           int64_t parsing_incr_duration_ns, int64_t serializing_duration_ns)
+           int64_t parsing_incr_duration_ns, int64_t serializing_duration_ns,
+           int64_t batch_serializing_duration_ns)
         : parser_(parser),
           key_len_(key_len),
           extras_len_(extras_len),
@@ -67,7 +69,8 @@ class MemcachedEvaluator {
           msg_size_parsed_(msg_size_parsed),
           parsing_duration_ns_(parsing_duration_ns),
           parsing_incr_duration_ns_(parsing_incr_duration_ns),
-          serializing_duration_ns_(serializing_duration_ns) {}
+          serializing_duration_ns_(serializing_duration_ns),
+          batch_serializing_duration_ns_(batch_serializing_duration_ns) {}
   };
 
   MemcachedEvaluator();
@@ -96,6 +99,8 @@ class MemcachedEvaluator {
   static const size_t kOutBufSize = 2 * 1024 * 1024;
   static const size_t kInBufSize = 2 * 1024 * 1024;
   static const size_t kSerBufSize = 2 * 1024 * 1024;
+  // responses per multi-get burst, serialized with serializeBatch()
+  static const size_t kBatchSize = 32;
 
   size_t key_len_ = 0;
   size_t extras_len_ = 0;
@@ -41,6 +41,7 @@
 #include "generation/preprocessing/scope_builder.h"
 #include "generation/preprocessing/transform_resolver.h"
 #include "generation/preprocessing/unit_scope_builder.h"
+#include "generation/preprocessing/unit_specializer.h"
 #include "spec/ast/module.h"
 #include "spec/ast/node.h"
 #include "spec/ast/visitor.h"
@@ -144,6 +145,7 @@ bool Compiler::executePasses(node_ptr<spec::ast::Module> module) {
   diffingo::generation::preprocessing::UnitScopeBuilder unit_scope_builder;
   diffingo::generation::preprocessing::IdResolver id_resolver;
   diffingo::generation::preprocessing::TransformResolver transform_resolver;
+  diffingo::generation::preprocessing::UnitSpecializer unit_specializer;
   diffingo::generation::preprocessing::InstantiationDependencyResolver
       inst_dep_resolver;
   diffingo::generation::preprocessing::InstantiationTypeGenerator
@@ -154,6 +156,7 @@ bool Compiler::executePasses(node_ptr<spec::ast::Module> module) {
   if (!executePass(module, &unit_scope_builder)) return false;
   if (!executePass(module, &id_resolver)) return false;
   if (!executePass(module, &transform_resolver)) return false;
+  if (!executePass(module, &unit_specializer)) return false;
   if (!executePass(module, &inst_dep_resolver)) return false;
   if (!executePass(module, &inst_type_generator)) return false;
 
@@ -46,6 +46,8 @@ struct Options {
   bool instantiation_only;
   bool input_pointers;
   bool store_parsing_only;
+  bool relative_offsets;
+  bool gather_serializing;
 };
 
 class Compiler {
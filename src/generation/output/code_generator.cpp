@@ -30,14 +30,15 @@
 #include <kode/code.h>
 #include <kode/enum.h>
 #include <kode/function.h>
-#include <kode/membervariable.h>
 #include <kode/printer.h>
 #include <pantheios/pantheios.hpp>
+#include <algorithm>
 #include <list>
 #include <memory>
 #include <string>
 
 #include "generation/output/translator.h"
+#include "runtime/unit/data_type.h"
 #include "spec/ast/declaration/declaration.h"
 #include "spec/ast/declaration/function.h"
 #include "spec/ast/declaration/transform.h"
@@ -48,10 +49,13 @@
 #include "spec/ast/id.h"
 #include "spec/ast/module.h"
 #include "spec/ast/node.h"
+#include "spec/ast/type/atomic_types.h"
+#include "spec/ast/type/container.h"
 #include "spec/ast/type/enum.h"
 #include "spec/ast/type/function.h"
 #include "spec/ast/type/unit.h"
 #include "spec/ast/visitor.h"
+#include "util/util.h"
 
 namespace ast = diffingo::spec::ast;
 namespace unit = diffingo::spec::ast::type::unit;
@@ -61,6 +65,16 @@ namespace diffingo {
 namespace generation {
 namespace output {
 
+namespace {
+
+const size_t kCacheLineSize = 64;
+
+size_t roundUp(size_t offset, size_t align) {
+  return (offset + align - 1) / align * align;
+}
+
+}  // namespace
+
 CodeGenerator::CodeGenerator(std::string file_name, std::string name_space) {
   file_.setFilename(file_name);
   file_.headerCode()->addLine("namespace dr = diffingo::runtime;");
@@ -72,6 +86,7 @@ CodeGenerator::~CodeGenerator() {}
 bool CodeGenerator::run(node_ptr<ast::Module> node, const Options& options) {
   module_ = node;
   options_ = &options;
+  translator_.set_relative_offsets(options.relative_offsets);
 
   // using custom traversal so that "type" children of fields aren't visited
   bool result = true;
@@ -127,9 +142,11 @@ void CodeGenerator::visit(node_ptr<spec::ast::declaration::Type> decl) {
 
   node_ptr<ast::type::Type> type = decl->type();
 
-  if (auto unit = ast::tryCast<unit::Unit>(type)) {
+  auto unit = ast::tryCast<unit::Unit>(type);
+  if (unit) {
     KODE::Class cls(translator_.unitName(decl->id()->name()));
     unit_cls_ = file_.insertClass(cls);
+    unit_members_.clear();
     unit_cls_->addHeaderInclude("runtime/runtime.h");
     unit_cls_->addHeaderInclude("stddef.h");
     unit_cls_->addHeaderInclude("cstdint");
@@ -141,12 +158,16 @@ void CodeGenerator::visit(node_ptr<spec::ast::declaration::Type> decl) {
       log(pantheios::error, unit, "error during parser generation");
     }
 
-    // generate and add serializer class
+    // generate and add serializer class, and the builder class if the unit
+    // gets one. the builder uses the serializer's macros and constants.
     KODE::Class serializer(translator_.unitSerializerName(decl->id()->name()));
     auto ptr_serializer = file_.insertClass(serializer);
-    if (!serializer_generator_.run(unit, ptr_serializer, *options_)) {
+    KODE::Class builder(translator_.unitBuilderName(decl->id()->name()));
+    if (!serializer_generator_.run(unit, ptr_serializer, &builder,
+                                   *options_)) {
       log(pantheios::error, unit, "error during parser generation");
     }
+    if (!builder.functions().empty()) file_.insertClass(builder);
   } else if (auto enum_t = ast::tryCast<ast::type::Enum>(type)) {
     std::list<KODE::Enum::label_with_value> labels;
     for (const auto& l : enum_t->labels()) {
@@ -154,7 +175,11 @@ void CodeGenerator::visit(node_ptr<spec::ast::declaration::Type> decl) {
                                       true, l.second);
       labels.push_back(lv);
     }
-    KODE::Enum _enum(translator_.enumName(decl->id()->name()), labels, true);
+    // KODE::Enum doesn't know enum bases, so the base is part of the name
+    KODE::Enum _enum(
+        util::fmt("%s : %s", translator_.enumName(decl->id()->name()),
+                  translator_.enumUnderlyingType(enum_t, nullptr)),
+        labels, true);
     file_.addFileEnum(_enum);
   } else {
     // TODO(ES) support other declarations
@@ -163,6 +188,8 @@ void CodeGenerator::visit(node_ptr<spec::ast::declaration::Type> decl) {
   for (auto c : type->children(false)) {
     processOne(c);
   }
+
+  if (unit) emitUnitMembers(unit, translator_.unitName(decl->id()->name()));
 }
 
 void CodeGenerator::visit(
@@ -209,17 +236,57 @@ void CodeGenerator::visit(node_ptr<unit::item::field::Ctor> node) {
 
 void diffingo::generation::output::CodeGenerator::visit(
     node_ptr<spec::ast::type::unit::item::field::switch_::Switch> node) {
-  // TODO(ES): support switch as union field
-
-  for (auto c : node->children(false)) {
+  // only the fields of a single case are ever set, so the cases share storage
+  // in an anonymous union. the parser records the (1-based) index of the
+  // parsed case, which the serializer dispatches on (after setting it from the
+  // switch expression, if there is one).
+  auto outer_fields = case_fields_;
+  std::list<std::list<UnitMember>> cases;
+  for (auto c : node->cases()) {
+    cases.emplace_back();
+    case_fields_ = &cases.back();
     processOne(c);
+    if (cases.back().empty()) cases.pop_back();
   }
+  case_fields_ = outer_fields;
+
+  // the case index is needed to access any of the fields
+  UnitMember index{translator_.unitSwitchCaseName(node),
+                   "uint8_t", 1, 1, false};
+  for (const auto& c : cases) {
+    for (const auto& f : c) index.hot |= f.hot;
+  }
+  addUnitField(index);
+
+  if (cases.size() == 1) {
+    // nothing to share storage with
+    for (const auto& f : cases.front()) addUnitField(f);
+    return;
+  } else if (cases.empty()) {
+    return;
+  }
+
+  // anonymous structs in unions are a (widely supported) compiler extension
+  UnitMember shared{"", "union { ", 0, 1, index.hot};
+  bool size_known = true;
+  for (auto& c : cases) {
+    size_t align;
+    size_t size = layoutMembers(&c, &align);
+    size_known &= size != 0;
+    shared.size = std::max(shared.size, size);
+    shared.align = std::max(shared.align, align);
+
+    if (c.size() > 1) shared.type += "struct { ";
+    for (const auto& f : c) shared.type += unitFieldDecl(f.name, f.type) + " ";
+    if (c.size() > 1) shared.type += "}; ";
+  }
+  shared.type += "}";
+  shared.size = size_known ? roundUp(shared.size, shared.align) : 0;
+  addUnitField(shared);
 }
 
 void diffingo::generation::output::CodeGenerator::visit(
     node_ptr<spec::ast::type::unit::item::field::switch_::Case> node) {
-  // TODO(ES): support cases in switch as union fields
-
   for (auto c : node->children(false)) {
     processOne(c);
   }
@@ -251,23 +318,170 @@ void CodeGenerator::addSingleUnitField(node_ptr<unit::item::Item> node) {
 
   std::string name = translator_.unitFieldName(node->id()->name());
   std::string type = translator_.type(node->type());
+  size_t fixed_length = 0;
+  size_t capacity = 0;
+  std::string inline_type;
+  if (translator_.fixedBytesLength(node, &fixed_length)) {
+    type = util::fmt("dr::unit::fixed_bytes<%d>", fixed_length);
+  } else if (translator_.inlineBytesType(node, &inline_type, &capacity)) {
+    type = inline_type;
+  }
 
+  UnitMember member{name, type, 0, 1, node->attributes()->has("hot")};
   auto field = ast::tryCast<unit::item::field::Field>(node);
-  if (field && !field->application_accessible() && options_->input_pointers) {
+  if (node->attributes()->has("file")) {
+    member.type = "dr::unit::file_range";
+    member.size = sizeof(runtime::unit::file_range);
+    member.align = alignof(runtime::unit::file_range);
+  } else if (field && !field->application_accessible() &&
+             options_->input_pointers) {
     // TODO(ES): figure out if field size is static constant => only use start
     // pointer. also figure out if start pointer is constant respective to other
     // field start pointer => only use length (or neither, if both are static.
     // then, nothing needs to be stored)
-    type = "dr::unit::var_stream_range";
+    member.type = "dr::unit::var_stream_range";
+    member.size = sizeof(runtime::unit::var_stream_range);
+    member.align = alignof(runtime::unit::var_stream_range);
+  } else if (fixed_length) {
+    member.size = fixed_length;
+  } else if (!inline_type.empty()) {
+    // bytes reference followed by the inline buffer
+    typeLayout(node->type(), &member.size, &member.align);
+    member.size = roundUp(member.size + capacity, member.align);
+  } else {
+    typeLayout(node->type(), &member.size, &member.align);
   }
 
-  addUnitField(name, type);
+  if (options_->relative_offsets) {
+    // only bytes and strings are stored relative to the unit area
+    if (node->attributes()->has("file")) {
+      log(pantheios::error, node,
+          "&file fields can't be relocated in relative offsets mode");
+    } else if (member.type == "dr::unit::var_stream_range") {
+      log(pantheios::error, node,
+          "input pointers can't be relocated in relative offsets mode");
+    } else if (ast::isA<unit::item::field::container::Container>(node)) {
+      log(pantheios::error, node,
+          "list and vector fields can't be relocated in relative offsets "
+          "mode");
+    }
+  }
+
+  addUnitField(member);
+
+  if (node->attributes()->has("patchable")) {
+    // offset of the field within the parsed message, see the serializer's
+    // patch functions
+    addUnitField(UnitMember{translator_.unitWireOffsetName(node->id()->name()),
+                            "uint32_t", 4, 4, member.hot});
+  }
+}
+
+void CodeGenerator::addUnitField(const UnitMember& member) {
+  // members are collected into the union of the enclosing switch, or laid out
+  // once the unit is complete (see emitUnitMembers)
+  if (case_fields_)
+    case_fields_->push_back(member);
+  else
+    unit_members_.push_back(member);
+}
+
+std::string CodeGenerator::unitFieldDecl(const std::string& name,
+                                         const std::string& type) const {
+  return name.empty() ? type + ";" : type + " " + name + ";";
+}
+
+void CodeGenerator::typeLayout(node_ptr<ast::type::Type> type, size_t* size,
+                               size_t* align) {
+  // sizes of the runtime's data types on the generating platform, which is
+  // assumed to be the target platform, too. a size of 0 means unknown.
+  *size = 0;
+  *align = sizeof(void*);
+  if (auto int_t = ast::tryCast<ast::type::Integer>(type)) {
+    *size = *align = static_cast<size_t>(int_t->width()) / 8;
+  } else if (ast::isA<ast::type::Bool>(type)) {
+    *size = *align = sizeof(bool);
+  } else if (ast::isA<ast::type::Double>(type)) {
+    *size = *align = sizeof(double);
+  } else if (auto enum_t = ast::tryCast<ast::type::Enum>(type)) {
+    translator_.enumUnderlyingType(enum_t, size);
+    *align = *size;
+  } else if (ast::isA<ast::type::Bytes>(type) ||
+             ast::isA<ast::type::String>(type)) {
+    // var_string and rel_string only derive from the bytes types
+    if (translator_.relative_offsets()) {
+      *size = sizeof(runtime::unit::rel_bytes);
+      *align = alignof(runtime::unit::rel_bytes);
+    } else {
+      *size = sizeof(runtime::unit::var_bytes);
+      *align = alignof(runtime::unit::var_bytes);
+    }
+  } else if (ast::isA<ast::type::List>(type)) {
+    // the element type doesn't change the layout of list<T>
+    *size = sizeof(runtime::unit::list<char>);
+    *align = alignof(runtime::unit::list<char>);
+  } else if (ast::isA<unit::Unit>(type)) {
+    // embedded unit, known if its declaration was generated before
+    auto it = unit_layouts_.find(translator_.type(type));
+    if (it != unit_layouts_.end()) {
+      *size = it->second.first;
+      *align = it->second.second;
+    }
+  }
+}
+
+size_t CodeGenerator::layoutMembers(std::list<UnitMember>* members,
+                                    size_t* align) const {
+  // hot members first, so that they share the first cache line(s). within
+  // each group, decreasing alignment avoids padding between the members. the
+  // sort is stable and only depends on the members, so units with the same
+  // fields (e.g. instantiations of the same unit) get the same relative order.
+  members->sort([](const UnitMember& a, const UnitMember& b) {
+    if (a.hot != b.hot) return a.hot;
+    return a.align > b.align;
+  });
+
+  size_t offset = 0;
+  bool size_known = true;
+  *align = 1;
+  for (const auto& m : *members) {
+    size_known &= m.size != 0;
+    offset = roundUp(offset, m.align) + m.size;
+    *align = std::max(*align, m.align);
+  }
+  return size_known ? roundUp(offset, *align) : 0;
 }
 
-void CodeGenerator::addUnitField(const std::string& name,
-                                 const std::string& type) {
-  KODE::MemberVariable v(name, type, false, KODE::MemberVariable::Public);
-  unit_cls_->addMemberVariable(v);
+void CodeGenerator::emitUnitMembers(node_ptr<unit::Unit> unit,
+                                    const std::string& cls_name) {
+  size_t align;
+  size_t size = layoutMembers(&unit_members_, &align);
+
+  unit_cls_->addDeclarationMacro("public:");
+  size_t offset = 0;
+  for (const auto& m : unit_members_) {
+    offset = roundUp(offset, m.align) + m.size;
+    if (m.hot && (m.size == 0 || offset > kCacheLineSize)) {
+      log(pantheios::warning, unit,
+          util::fmt("hot member %s of %s may not fit into the first cache line",
+                    m.name, cls_name));
+    }
+
+    // declared as written, an empty name declares an anonymous member (e.g. a
+    // switch's union)
+    unit_cls_->addDeclarationMacro(unitFieldDecl(m.name, m.type));
+  }
+  unit_members_.clear();
+
+  // record the resulting layout for embedding units. sizes are only known if
+  // those of all members are, so the generated code can check them against the
+  // compiler's.
+  unit_layouts_[cls_name] = std::make_pair(size, align);
+  if (size) {
+    file_.fileCode()->addLine(
+        util::fmt("static_assert(sizeof(%s) == %d, \"unexpected size of %s\");",
+                  cls_name, size, cls_name));
+  }
 }
 
 }  // namespace output
@@ -28,8 +28,11 @@
 #define SRC_GENERATION_OUTPUT_CODE_GENERATOR_H_
 
 #include <kode/file.h>
+#include <list>
+#include <map>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "generation/compiler.h"  // NOLINT
 #include "generation/output/translator.h"
@@ -85,9 +88,27 @@ class CodeGenerator : public spec::ast::Visitor<> {
   void visit(node_ptr<spec::ast::type::unit::item::Variable> node) override;
 
  private:
+  // a member of the generated unit struct, with its size and alignment in
+  // bytes. a size of 0 means that the size isn't known to the generator.
+  struct UnitMember {
+    std::string name;
+    std::string type;
+    size_t size;
+    size_t align;
+    bool hot;
+  };
+
   void addSingleUnitField(
       spec::ast::node_ptr<spec::ast::type::unit::item::Item> node);
-  void addUnitField(const std::string& name, const std::string& type);
+  void addUnitField(const UnitMember& member);
+  std::string unitFieldDecl(const std::string& name,
+                            const std::string& type) const;
+
+  void typeLayout(node_ptr<spec::ast::type::Type> type, size_t* size,
+                  size_t* align);
+  size_t layoutMembers(std::list<UnitMember>* members, size_t* align) const;
+  void emitUnitMembers(node_ptr<spec::ast::type::unit::Unit> unit,
+                       const std::string& cls_name);
 
   Translator translator_;
   parsing::ParserGenerator parser_generator_;
@@ -97,6 +118,12 @@ class CodeGenerator : public spec::ast::Visitor<> {
   KODE::File file_;
   KODE::Class* unit_cls_ = nullptr;
   KODE::Function* function_ = nullptr;
+  // members of the unit currently visited, emitted once it is complete
+  std::list<UnitMember> unit_members_;
+  // fields of the switch case currently visited
+  std::list<UnitMember>* case_fields_ = nullptr;
+  // (size, alignment) of the units generated so far, by class name
+  std::map<std::string, std::pair<size_t, size_t>> unit_layouts_;
 
   const Options* options_ = nullptr;
 };
@@ -50,6 +50,8 @@
 #include "spec/ast/expression/operator.h"
 #include "spec/ast/expression/parser_state.h"
 #include "spec/ast/expression/type.h"
+#include "spec/ast/expression/variable.h"
+#include "spec/ast/variable/variable.h"
 #include "spec/ast/id.h"
 #include "spec/ast/node.h"
 #include "spec/ast/visitor.h"
@@ -277,6 +279,12 @@ void ExpressionTranslator::visit(node_ptr<ast::expression::Type> node) {
   setResult(translator_->type(node->contained_type()));
 }
 
+void ExpressionTranslator::visit(node_ptr<ast::expression::Variable> node) {
+  // TODO(ES): currently only supporting local variables, e.g. of lambdas,
+  // which are declared by the generated code with the same name.
+  setResult(node->variable()->id()->name());
+}
+
 void ExpressionTranslator::visit(node_ptr<ast::constant::Bitset> node) {
   // TODO(ES): support bitsets
 }
@@ -50,6 +50,7 @@
 #include "spec/ast/expression/operator.h"
 #include "spec/ast/expression/parser_state.h"
 #include "spec/ast/expression/type.h"
+#include "spec/ast/expression/variable.h"
 #include "spec/ast/node.h"
 #include "spec/ast/visitor.h"
 
@@ -89,6 +90,7 @@ class ExpressionTranslator : public spec::ast::Visitor<std::string> {
   void visit(node_ptr<spec::ast::expression::Operator> node) override;
   void visit(node_ptr<spec::ast::expression::ParserState> node) override;
   void visit(node_ptr<spec::ast::expression::Type> node) override;
+  void visit(node_ptr<spec::ast::expression::Variable> node) override;
 
   void visit(node_ptr<spec::ast::constant::Bitset> node) override;
   void visit(node_ptr<spec::ast::constant::Bool> node) override;
@@ -26,13 +26,24 @@
 
 #include "generation/output/translator.h"
 
+#include <cctype>
+#include <cstdint>
 #include <string>
 
+#include "spec/ast/attribute.h"
+#include "spec/ast/constant/bool.h"
+#include "spec/ast/constant/integer.h"
+#include "spec/ast/constant/string.h"
+#include "spec/ast/constant/tuple.h"
 #include "spec/ast/exception.h"
+#include "spec/ast/expression/constant.h"
 #include "spec/ast/expression/expression.h"
 #include "spec/ast/id.h"
 #include "spec/ast/node.h"
+#include "spec/ast/type/atomic_types.h"
+#include "spec/ast/type/enum.h"
 #include "spec/ast/type/type.h"
+#include "spec/ast/type/unit.h"
 #include "util/util.h"
 
 namespace diffingo {
@@ -41,6 +52,11 @@ namespace output {
 
 Translator::Translator() : expression_translator_(this) {}
 
+void Translator::set_relative_offsets(bool relative) {
+  relative_offsets_ = relative;
+  type_translator_.set_relative_offsets(relative);
+}
+
 std::string Translator::moduleNamespace(node_ptr<spec::ast::ID> id) const {
   return util::fmt("diffingo::gen::%s", id->name());
 }
@@ -63,12 +79,171 @@ std::string Translator::unitVarName(const std::string& name) const {
   return name;
 }
 
+std::string Translator::unitSwitchCaseName(
+    node_ptr<spec::ast::type::unit::item::field::switch_::Switch> sw) const {
+  namespace ast = spec::ast;
+
+  if (!sw->anonymous() || !sw->unit())
+    return sw->id()->name() + "_case";
+
+  size_t index = 0;
+  for (auto item : sw->unit()->flattenedItems()) {
+    if (!ast::isA<ast::type::unit::item::field::switch_::Switch>(item))
+      continue;
+    ++index;
+    if (item.get() == sw.get()) break;
+  }
+  return util::fmt("switch%d_case", index);
+}
+
+std::string Translator::unitWireOffsetName(const std::string& name) const {
+  return name + "_offset";
+}
+
+std::string Translator::patchFunctionName(const std::string& name) const {
+  return "patch_" + name;
+}
+
 std::string Translator::enumName(const std::string& name) const { return name; }
 
 std::string Translator::enumLabel(const std::string& label) const {
   return label;
 }
 
+std::string Translator::enumUnderlyingType(
+    node_ptr<spec::ast::type::Enum> enum_t, size_t* width) const {
+  int min = 0;
+  int max = 0;
+  for (const auto& l : enum_t->labels()) {
+    if (l.second < min) min = l.second;
+    if (l.second > max) max = l.second;
+  }
+
+  // narrowest integer type holding all label values (incl. UNDEF = -1)
+  bool is_signed = min < 0;
+  size_t bytes = 4;
+  if (is_signed ? (min >= INT8_MIN && max <= INT8_MAX) : max <= UINT8_MAX)
+    bytes = 1;
+  else if (is_signed ? (min >= INT16_MIN && max <= INT16_MAX)
+                     : max <= UINT16_MAX)
+    bytes = 2;
+
+  if (width) *width = bytes;
+  return util::fmt("%sint%d_t", is_signed ? "" : "u", bytes * 8);
+}
+
+std::string Translator::transformName(const std::string& name) const {
+  return "dr::transform::" + name;
+}
+
+bool Translator::fixedBytesLength(
+    node_ptr<spec::ast::type::unit::item::Item> item, size_t* length) const {
+  namespace ast = spec::ast;
+
+  if (!ast::tryCast<ast::type::Bytes>(item->type())) return false;
+  if (!item->attributes()->has("length")) return false;
+
+  auto expr = ast::tryCast<ast::expression::Constant>(
+      item->attributes()->lookup("length")->value());
+  if (!expr) return false;
+  auto len = ast::tryCast<ast::constant::Integer>(expr->constant());
+  // zero-length arrays are ill-formed, such fields take the normal path
+  if (!len || len->value() <= 0) return false;
+
+  *length = static_cast<size_t>(len->value());
+  return true;
+}
+
+bool Translator::inlineBytesType(
+    node_ptr<spec::ast::type::unit::item::Item> item, std::string* type,
+    size_t* capacity) const {
+  namespace ast = spec::ast;
+
+  bool string = ast::isA<ast::type::String>(item->type());
+  if (!string && !ast::isA<ast::type::Bytes>(item->type())) return false;
+  if (!item->attributes()->has("inline")) return false;
+
+  auto expr = ast::tryCast<ast::expression::Constant>(
+      item->attributes()->lookup("inline")->value());
+  if (!expr) return false;
+  auto value = ast::tryCast<ast::constant::Integer>(expr->constant());
+  if (!value || value->value() <= 0) return false;
+
+  std::string kind = string ? "string" : "bytes";
+  std::string base = relative_offsets_ ? ", dr::unit::rel_" + kind : "";
+  *type = util::fmt("dr::unit::inline_%s<%d%s>", kind, value->value(), base);
+  if (capacity) *capacity = static_cast<size_t>(value->value());
+  return true;
+}
+
+bool Translator::serializedConstant(
+    node_ptr<spec::ast::constant::Constant> constant, bool big_endian,
+    std::string* bytes) const {
+  namespace ast = spec::ast;
+
+  if (auto c = ast::tryCast<ast::constant::String>(constant)) {
+    bytes->append(c->value());
+    return true;
+  } else if (auto c = ast::tryCast<ast::constant::Bool>(constant)) {
+    bytes->push_back(c->value() ? 1 : 0);
+    return true;
+  } else if (auto c = ast::tryCast<ast::constant::Integer>(constant)) {
+    auto type = ast::tryCast<ast::type::Integer>(c->type());
+    if (!type || type->width() % 8 != 0) return false;
+    int len = type->width() / 8;
+    uint64_t value = static_cast<uint64_t>(c->value());
+    for (int i = 0; i < len; i++) {
+      int shift = 8 * (big_endian ? len - 1 - i : i);
+      bytes->push_back(static_cast<char>((value >> shift) & 0xff));
+    }
+    return true;
+  } else if (auto c = ast::tryCast<ast::constant::Tuple>(constant)) {
+    for (auto e : c->value()) {
+      auto ec = ast::tryCast<ast::expression::Constant>(e);
+      if (!ec || !serializedConstant(ec->constant(), big_endian, bytes))
+        return false;
+    }
+    return true;
+  }
+
+  // TODO(ES): support enums, bitsets, doubles
+  return false;
+}
+
+node_ptr<spec::ast::type::Integer> Translator::constantIntegerType(
+    node_ptr<spec::ast::constant::Constant> constant) const {
+  namespace ast = spec::ast;
+
+  if (auto c = ast::tryCast<ast::constant::Integer>(constant))
+    return ast::tryCast<ast::type::Integer>(c->type());
+  if (auto c = ast::tryCast<ast::constant::Tuple>(constant)) {
+    for (auto e : c->value()) {
+      auto ec = ast::tryCast<ast::expression::Constant>(e);
+      if (!ec) continue;
+      if (auto type = constantIntegerType(ec->constant())) return type;
+    }
+  }
+  return nullptr;
+}
+
+std::string Translator::bytesLiteral(const std::string& bytes) const {
+  std::string literal = "\"";
+  bool last_escaped = false;
+  for (char ch : bytes) {
+    auto c = static_cast<unsigned char>(ch);
+    // hex escapes are greedy, so a following hex digit must be escaped, too.
+    if (c == '"' || c == '\\' || c == '?' || !std::isprint(c) ||
+        (last_escaped && std::isxdigit(c))) {
+      literal += util::fmt("\\x%02x", static_cast<int>(c));
+      last_escaped = true;
+    } else {
+      literal += static_cast<char>(c);
+      last_escaped = false;
+    }
+  }
+  return literal + "\"";
+}
+
 std::string Translator::type(node_ptr<spec::ast::type::Type> type) {
   std::string result;
   bool success = type_translator_.translate(type, &result);
@@ -85,6 +260,10 @@ std::string Translator::unitSerializerName(const std::string& name) const {
   return unitName(name) + "Serializer";
 }
 
+std::string Translator::unitBuilderName(const std::string& name) const {
+  return unitName(name) + "Builder";
+}
+
 std::string Translator::expression(
     node_ptr<spec::ast::expression::Expression> expr) {
   std::string result;
@@ -31,10 +31,14 @@
 
 #include "generation/output/expression_translator.h"
 #include "generation/output/type_translator.h"
+#include "spec/ast/constant/constant.h"
 #include "spec/ast/expression/expression.h"
 #include "spec/ast/id.h"
 #include "spec/ast/node.h"
+#include "spec/ast/type/atomic_types.h"
+#include "spec/ast/type/enum.h"
 #include "spec/ast/type/type.h"
+#include "spec/ast/type/unit.h"
 
 namespace diffingo {
 namespace generation {
@@ -46,6 +50,11 @@ class Translator {
  public:
   Translator();
 
+  /// Translate references within units to relative offsets (see
+  /// Options::relative_offsets).
+  void set_relative_offsets(bool relative);
+  bool relative_offsets() const { return relative_offsets_; }
+
   std::string moduleNamespace(node_ptr<spec::ast::ID> id) const;
 
   std::string functionName(const std::string &name) const;
@@ -54,11 +63,52 @@ class Translator {
   std::string unitName(const std::string &name) const;
   std::string unitFieldName(const std::string &name) const;
   std::string unitVarName(const std::string &name) const;
+  /// Member recording the parsed case of a switch. Switches are anonymous,
+  /// so they are named after their position among the unit's switches.
+  std::string unitSwitchCaseName(
+      node_ptr<spec::ast::type::unit::item::field::switch_::Switch> sw) const;
+  /// Member recording the wire offset of a &patchable field.
+  std::string unitWireOffsetName(const std::string &name) const;
+  std::string patchFunctionName(const std::string &name) const;
   std::string unitParserName(const std::string &name) const;
   std::string unitSerializerName(const std::string &name) const;
+  std::string unitBuilderName(const std::string &name) const;
 
   std::string enumName(const std::string &name) const;
   std::string enumLabel(const std::string &label) const;
+  /// Returns the narrowest integer type that can hold all labels of the enum
+  /// and sets width to its size in bytes (if not null).
+  std::string enumUnderlyingType(node_ptr<spec::ast::type::Enum> enum_t,
+                                 size_t *width) const;
+
+  std::string transformName(const std::string &name) const;
+
+  /// Converts a constant into its serialized byte representation. Returns
+  /// false if the constant has no static serialized form.
+  bool serializedConstant(node_ptr<spec::ast::constant::Constant> constant,
+                          bool big_endian, std::string *bytes) const;
+
+  /// Returns the type of the first integer in the constant, including the
+  /// elements of tuples, or nullptr if it contains none. All integers of a
+  /// constant are serialized in the byte order of its field.
+  node_ptr<spec::ast::type::Integer> constantIntegerType(
+      node_ptr<spec::ast::constant::Constant> constant) const;
+
+  /// Returns a C++ string literal holding the given bytes.
+  std::string bytesLiteral(const std::string &bytes) const;
+
+  /// Returns true if the item is a bytes field whose length attribute is a
+  /// positive constant. Such fields are stored inline as
+  /// dr::unit::fixed_bytes.
+  bool fixedBytesLength(node_ptr<spec::ast::type::unit::item::Item> item,
+                        size_t *length) const;
+
+  /// Returns true if the item is a bytes or string field with an &inline
+  /// attribute giving the capacity for storing short values inline. Sets
+  /// type to the dr::unit::inline_bytes/inline_string type of the field and
+  /// capacity to the inline capacity (if not null).
+  bool inlineBytesType(node_ptr<spec::ast::type::unit::item::Item> item,
+                       std::string *type, size_t *capacity = nullptr) const;
 
   std::string type(node_ptr<spec::ast::type::Type> type);
 
@@ -67,6 +117,7 @@ class Translator {
  private:
   TypeTranslator type_translator_;
   ExpressionTranslator expression_translator_;
+  bool relative_offsets_ = false;
 };
 
 }  // namespace output
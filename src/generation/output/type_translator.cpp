@@ -41,6 +41,7 @@
 #include "spec/ast/type/type.h"
 #include "spec/ast/type/unit.h"
 #include "spec/ast/visitor.h"
+#include "util/util.h"
 
 namespace ast = diffingo::spec::ast;
 
@@ -82,8 +83,7 @@ void TypeTranslator::visit(node_ptr<ast::type::Bool> node) {
 }
 
 void TypeTranslator::visit(node_ptr<ast::type::Bytes> node) {
-  // TODO(ES): support constant-length bytes fields?
-  setResult("dr::unit::var_bytes");
+  setResult(relative_offsets_ ? "dr::unit::rel_bytes" : "dr::unit::var_bytes");
 }
 
 void TypeTranslator::visit(node_ptr<ast::type::CAddr> node) {
@@ -113,7 +113,11 @@ void TypeTranslator::visit(node_ptr<ast::type::Integer> node) {
 }
 
 void TypeTranslator::visit(node_ptr<ast::type::List> node) {
-  // TODO(ES): support List
+  // TODO(ES): support lists of atomic types (dr::unit::list_of_atomics)
+  // TODO(ES): relocatable lists for relative offsets mode
+  std::string elem;
+  processOne(node->element_type(), &elem);
+  setResult(util::fmt("dr::unit::list<%s>", elem));
 }
 
 void TypeTranslator::visit(node_ptr<ast::type::Map> node) {
@@ -133,7 +137,8 @@ void TypeTranslator::visit(node_ptr<ast::type::Sink> node) {
 }
 
 void TypeTranslator::visit(node_ptr<ast::type::String> node) {
-  setResult("dr::unit::var_string");
+  setResult(relative_offsets_ ? "dr::unit::rel_string"
+                              : "dr::unit::var_string");
 }
 
 void TypeTranslator::visit(node_ptr<ast::type::Tuple> node) {
@@ -53,6 +53,9 @@ class TypeTranslator : public spec::ast::Visitor<std::string> {
 
   bool translate(node_ptr<spec::ast::type::Type> node, std::string* result);
 
+  /// Use relocatable types with relative offsets instead of pointers.
+  void set_relative_offsets(bool relative) { relative_offsets_ = relative; }
+
   using Visitor::visit;
 
   void visit(node_ptr<spec::ast::type::Bitset> node) override;
@@ -77,6 +80,8 @@ class TypeTranslator : public spec::ast::Visitor<std::string> {
 
  private:
   static const std::string kDefaultResult;
+
+  bool relative_offsets_ = false;
 };
 
 }  // namespace output
@@ -0,0 +1,288 @@
+/*
+ * look_ahead.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "generation/parsing/look_ahead.h"
+
+#include <stddef.h>
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace diffingo {
+namespace generation {
+namespace parsing {
+namespace look_ahead {
+
+const uint8_t Table::kSecondLevel;
+const size_t Table::kMaxCases;
+
+namespace {
+
+ByteSet byteRange(size_t from, size_t to) {
+  ByteSet set;
+  for (size_t c = from; c <= to; c++) set.set(c);
+  return set;
+}
+
+// Returns the only element of a set of one byte.
+size_t onlyByte(const ByteSet& set) {
+  size_t c = 0;
+  while (!set.test(c)) c++;
+  return c;
+}
+
+ByteSet escapeSet(char c) {
+  switch (c) {
+    case 'd':
+      return byteRange('0', '9');
+    case 'w':
+      return byteRange('0', '9') | byteRange('a', 'z') |
+             byteRange('A', 'Z') | byteRange('_', '_');
+    case 's':
+      return byteRange(' ', ' ') | byteRange('\t', '\r');
+    case 'D':
+      return ~byteRange('0', '9');
+    case 'S':
+      return ~(byteRange(' ', ' ') | byteRange('\t', '\r'));
+    case 'r':
+      return byteRange('\r', '\r');
+    case 'n':
+      return byteRange('\n', '\n');
+    case 't':
+      return byteRange('\t', '\t');
+    default:
+      return byteRange(static_cast<unsigned char>(c),
+                       static_cast<unsigned char>(c));
+  }
+}
+
+// Parses a character class starting after its opening bracket.
+bool parseClass(const std::string& p, size_t* i, ByteSet* set) {
+  bool negate = false;
+  if (*i < p.size() && p[*i] == '^') {
+    negate = true;
+    (*i)++;
+  }
+
+  ByteSet result;
+  bool first = true;
+  while (*i < p.size() && (p[*i] != ']' || first)) {
+    first = false;
+    size_t from;
+    if (p[*i] == '\\') {
+      if (++(*i) >= p.size()) return false;
+      ByteSet escaped = escapeSet(p[(*i)++]);
+      if (escaped.count() != 1) {
+        result |= escaped;
+        continue;
+      }
+      from = onlyByte(escaped);
+    } else {
+      from = static_cast<unsigned char>(p[(*i)++]);
+    }
+
+    if (*i + 1 < p.size() && p[*i] == '-' && p[*i + 1] != ']') {
+      (*i)++;
+      size_t to;
+      if (p[*i] == '\\') {
+        if (++(*i) >= p.size()) return false;
+        ByteSet escaped = escapeSet(p[(*i)++]);
+        if (escaped.count() != 1) return false;
+        to = onlyByte(escaped);
+      } else {
+        to = static_cast<unsigned char>(p[(*i)++]);
+      }
+      if (to < from) return false;
+      result |= byteRange(from, to);
+    } else {
+      result.set(from);
+    }
+  }
+  if (*i >= p.size()) return false;
+  (*i)++;  // closing bracket
+
+  *set = negate ? ~result : result;
+  return true;
+}
+
+// Parses a single atom of a regular expression. Returns false for unsupported
+// constructs, such as groups and alternatives.
+bool parseAtom(const std::string& p, size_t* i, ByteSet* set) {
+  if (*i >= p.size()) return false;
+  char c = p[(*i)++];
+  switch (c) {
+    case '\\':
+      if (*i >= p.size()) return false;
+      *set = escapeSet(p[(*i)++]);
+      return true;
+    case '[':
+      return parseClass(p, i, set);
+    case '.':
+      *set = ~byteRange('\n', '\n');
+      return true;
+    case '(':
+    case ')':
+    case '|':
+    case '^':
+    case '$':
+    case '{':
+    case '?':
+    case '*':
+    case '+':
+      return false;
+    default:
+      *set = byteRange(static_cast<unsigned char>(c),
+                       static_cast<unsigned char>(c));
+      return true;
+  }
+}
+
+char parseQuantifier(const std::string& p, size_t* i) {
+  if (*i < p.size() &&
+      (p[*i] == '?' || p[*i] == '*' || p[*i] == '+' || p[*i] == '{')) {
+    return p[(*i)++];
+  }
+  return 0;
+}
+
+Prefix patternPrefix(const std::string& p) {
+  Prefix prefix = anyPrefix();
+  size_t i = 0;
+  for (size_t k = 0; k < kDepth; k++) {
+    ByteSet set;
+    if (!parseAtom(p, &i, &set)) break;
+
+    // optional atoms would need the following atoms to be considered, too.
+    char quantifier = parseQuantifier(p, &i);
+    if (quantifier == '?' || quantifier == '*' || quantifier == '{') break;
+
+    prefix[k] = set;
+
+    if (quantifier == '+') {
+      // the next position is either a repetition or the following atom.
+      ByteSet next;
+      char next_quantifier = 0;
+      if (k + 1 < kDepth && parseAtom(p, &i, &next)) {
+        next_quantifier = parseQuantifier(p, &i);
+        if (next_quantifier == 0 || next_quantifier == '+')
+          prefix[k + 1] = set | next;
+      }
+      break;
+    }
+  }
+  return prefix;
+}
+
+}  // namespace
+
+Prefix anyPrefix() {
+  Prefix prefix;
+  for (auto& set : prefix) set.set();
+  return prefix;
+}
+
+Prefix bytesPrefix(const std::string& bytes) {
+  Prefix prefix = anyPrefix();
+  for (size_t k = 0; k < kDepth && k < bytes.size(); k++) {
+    prefix[k].reset();
+    prefix[k].set(static_cast<unsigned char>(bytes[k]));
+  }
+  return prefix;
+}
+
+Prefix regExpPrefix(const spec::ast::ctor::RegExp::pattern_list& patterns) {
+  Prefix prefix;
+  for (auto pattern : patterns) {
+    auto p = patternPrefix(pattern);
+    for (size_t k = 0; k < kDepth; k++) prefix[k] |= p[k];
+  }
+  return prefix;
+}
+
+Table buildTable(const std::vector<Prefix>& cases) {
+  Table table;
+  table.first.assign(256, 0);
+
+  // identical second level tables are shared
+  std::map<std::string, size_t> second_tables;
+
+  for (size_t b = 0; b < 256; b++) {
+    std::vector<size_t> candidates;
+    for (size_t c = 0; c < cases.size(); c++) {
+      if (cases[c][0].test(b)) candidates.push_back(c);
+    }
+
+    if (candidates.empty()) continue;
+    if (candidates.size() == 1) {
+      table.first[b] = static_cast<char>(candidates.front() + 1);
+      continue;
+    }
+
+    // consult the second byte. cases are tried in order of declaration, so
+    // the first candidate wins if the second byte doesn't decide either.
+    std::string second(256, 0);
+    for (size_t b2 = 0; b2 < 256; b2++) {
+      size_t matches = 0;
+      for (auto c : candidates) {
+        if (!cases[c][1].test(b2)) continue;
+        if (matches++ == 0) {
+          second[b2] = static_cast<char>(c + 1);
+        } else if (std::find(table.ambiguous.begin(), table.ambiguous.end(),
+                             c + 1) == table.ambiguous.end()) {
+          table.ambiguous.push_back(c + 1);
+        }
+      }
+    }
+
+    auto it = second_tables.find(second);
+    if (it == second_tables.end() &&
+        second_tables.size() == Table::kSecondLevel) {
+      // out of second level table ids
+      table.first[b] = static_cast<char>(candidates.front() + 1);
+      for (auto c = candidates.begin() + 1; c != candidates.end(); c++) {
+        if (std::find(table.ambiguous.begin(), table.ambiguous.end(),
+                      *c + 1) == table.ambiguous.end())
+          table.ambiguous.push_back(*c + 1);
+      }
+      continue;
+    } else if (it == second_tables.end()) {
+      it = second_tables.insert(std::make_pair(second, second_tables.size()))
+               .first;
+      table.second += second;
+    }
+    table.first[b] = static_cast<char>(Table::kSecondLevel | it->second);
+  }
+
+  return table;
+}
+
+}  // namespace look_ahead
+}  // namespace parsing
+}  // namespace generation
+}  // namespace diffingo
@@ -0,0 +1,92 @@
+/*
+ * look_ahead.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef SRC_GENERATION_PARSING_LOOK_AHEAD_H_
+#define SRC_GENERATION_PARSING_LOOK_AHEAD_H_
+
+#include <stddef.h>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "spec/ast/ctor/reg_exp.h"
+
+namespace diffingo {
+namespace generation {
+namespace parsing {
+namespace look_ahead {
+
+/// Set of byte values.
+typedef std::bitset<256> ByteSet;
+
+/// Number of input bytes considered for look-ahead dispatch.
+const size_t kDepth = 2;
+
+/// Sets of bytes that may appear at the first kDepth positions of a field's
+/// input. Positions that can't be determined statically contain all bytes.
+typedef std::array<ByteSet, kDepth> Prefix;
+
+/// Returns a prefix that matches any input.
+Prefix anyPrefix();
+
+/// Returns the prefix of a fixed byte sequence.
+Prefix bytesPrefix(const std::string& bytes);
+
+/// Returns the prefix of any of the given regular expression patterns. Only a
+/// simple subset of regular expressions (literals, classes, escapes and
+/// quantifiers on them) is analyzed, other constructs match any input.
+Prefix regExpPrefix(const spec::ast::ctor::RegExp::pattern_list& patterns);
+
+/// Look-ahead dispatch tables for a switch with cases of the given prefixes.
+///
+/// first[b] is 0 if no case can start with byte b, the 1-based case number if
+/// byte b determines the case, or kSecondLevel | k if the second byte needs to
+/// be consulted in second[k * 256 + b2].
+struct Table {
+  static const uint8_t kSecondLevel = 0x80;
+  static const size_t kMaxCases = kSecondLevel - 1;
+
+  std::string first;
+  std::string second;
+
+  /// Case numbers that couldn't be distinguished from an earlier case for some
+  /// inputs. The earlier case is chosen in that case.
+  std::vector<size_t> ambiguous;
+};
+
+/// Builds the dispatch tables for the given case prefixes. The number of
+/// prefixes must not exceed Table::kMaxCases.
+Table buildTable(const std::vector<Prefix>& cases);
+
+}  // namespace look_ahead
+}  // namespace parsing
+}  // namespace generation
+}  // namespace diffingo
+
+#endif  // SRC_GENERATION_PARSING_LOOK_AHEAD_H_
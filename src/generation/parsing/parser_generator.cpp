@@ -33,14 +33,21 @@
 #include <pantheios/pantheios.hpp>
 #include <iostream>
 #include <list>
+#include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "generation/compiler.h"
+#include "generation/parsing/look_ahead.h"
 #include "spec/ast/attribute.h"
 #include "spec/ast/constant/constant.h"
 #include "spec/ast/constant/enum.h"
+#include "spec/ast/ctor/bytes.h"
+#include "spec/ast/ctor/reg_exp.h"
 #include "spec/ast/expression/constant.h"
+#include "spec/ast/expression/member_attribute.h"
+#include "spec/ast/expression/transform.h"
 #include "spec/ast/id.h"
 #include "spec/ast/node.h"
 #include "spec/ast/type/atomic_types.h"
@@ -69,10 +76,10 @@ bool ParserGenerator::run(node_ptr<ast::type::unit::Unit> node,
   root_instr_ = newInstructionLabel("root");
   unit_ = node;
   options_ = &options;
+  translator_.set_relative_offsets(options.relative_offsets);
+  planMessageAllocation();
 
   // -- create code blocks that will be filled during visiting unit elements --
-  KODE::Code init_consts_body;
-  init_consts_code_ = &init_consts_body;
   KODE::Code parse_body_inner;
   code_ = &parse_body_inner;
 
@@ -108,7 +115,18 @@ bool ParserGenerator::run(node_ptr<ast::type::unit::Unit> node,
   // push new block state, allocate space for unit in area and set pointer
   // within state to point to it
   emitPushBlockState();
-  emitAllocateIntoPointerPointer(exprCurrentUnitPP());
+  if (alloc_item_) {
+    // the unit is only allocated together with its variable-length fields
+    // once their lengths are known, so that input failing to parse before
+    // doesn't consume any space in the area.
+    code_->addLine(util::fmt("if (area->space() < sizeof(%s))",
+                             translator_.type(unit_)));
+    code_->addLine("  return dr::parsing::ParseResult::AREA_FULL;");
+    code_->addLine("BLOCKSTATE->unit = area->nextPos();");
+    code_->newLine();
+  } else {
+    emitAllocateIntoPointerPointer(exprCurrentUnitPP());
+  }
   code_->addLine("unit = BLOCKSTATE->unit;");
 
   // init stream position
@@ -130,23 +148,26 @@ bool ParserGenerator::run(node_ptr<ast::type::unit::Unit> node,
       "#define UNITPP(type) reinterpret_cast<type**>(&BLOCKSTATE->unit)");
   cls_->addDeclarationMacro("#define SELF(type) (*UNIT(type))");
 
-  // create parser constants struct
+  // create parser constants struct. constants are static constexpr data, so
+  // parsers don't need to initialize them and can share them across threads.
   KODE::Class consts("ParserConstants");
-  for (auto m : consts_) {
-    consts.addMemberVariable(m);
+  consts.addDeclarationMacro("public:");
+  for (auto c : consts_) {
+    consts.addDeclarationMacro(
+        util::fmt("static constexpr const char* %s = %s;", c.first,
+                  translator_.bytesLiteral(c.second)));
   }
   parser_cls->addNestedClass(consts);
-  KODE::MemberVariable consts_var("consts_", "ParserConstants", false, true);
-  parser_cls->addMemberVariable(consts_var);
-  KODE::Function init_consts("initParserConstants", "void",
-                             KODE::Function::Private, false);
-  init_consts.setBody(init_consts_body);
-  parser_cls->addFunction(init_consts);
 
   // TODO(ES): create block state entry struct(s)
   KODE::Class block_state("BlockState");
   KODE::MemberVariable bs_unit("unit", "char*", false, true);
   block_state.addMemberVariable(bs_unit);
+  if (alloc_item_) {
+    // next free byte of the unit's up-front allocation
+    KODE::MemberVariable bs_var_pos("var_pos", "char*", false, true);
+    block_state.addMemberVariable(bs_var_pos);
+  }
   parser_cls->addNestedClass(block_state);
 
   // generate and add parse function
@@ -188,8 +209,6 @@ void ParserGenerator::visit(
       code_->addLine(util::fmt("%s->%s = (%s) %s;", exprCurrentUnit(),
                                translator_.unitFieldName(node->id()->name()),
                                translator_.type(node->type()), temp_name));
-    } else if (node->attributes()->has("transform")) {
-      // TODO(ES): support custom transforms
     } else {
       log(pantheios::error, node,
           "unknown case for serialized type != internal type");
@@ -210,11 +229,20 @@ void ParserGenerator::visit(
 
 void ParserGenerator::visit(
     node_ptr<ast::type::unit::item::field::Constant> node) {
-  // TODO(ES)
   // statically convert constant to byte array in serialized format
-  // add constant field to unit's "ParserConstants" struct
-  // check for length
-  // check for equality to constant
+  std::string bytes;
+  if (!serializedConstant(node, &bytes)) {
+    log(pantheios::error, node, "constant has no static serialized form");
+    return;
+  }
+
+  // add constant field to unit's "ParserConstants" struct, then check for
+  // length and equality to constant
+  code_->addLine(util::fmt(
+      "parse_res = dr::parsing::util::matchConstant<%d>("
+      "POS, in_buf_end, ParserConstants::%s);",
+      bytes.size(), addConstant(bytes)));
+  emitCheckParseResult();
 }
 
 void ParserGenerator::visit(node_ptr<ast::type::unit::item::field::Unit> node) {
@@ -242,11 +270,10 @@ void ParserGenerator::visit(
 
 void ParserGenerator::visit(
     node_ptr<spec::ast::type::unit::item::field::switch_::Switch> node) {
-  // TODO(ES): support switch as union struct - also store which switch path /
-  // fields are used in the unit
   if (node->expression()) {
     code_->addLine(
         util::fmt("switch (%s){", translator_.expression(node->expression())));
+    size_t index = 0;
     for (auto c : node->cases()) {
       for (auto e : c->expressions()) {
         code_->addLine(util::fmt("case %s:", translator_.expression(e)));
@@ -255,6 +282,7 @@ void ParserGenerator::visit(
         code_->addLine("default:");
       }
       code_->indent();
+      emitSwitchCase(node, ++index);
       for (auto x : c->items()) {
         parse(x);
       }
@@ -263,7 +291,7 @@ void ParserGenerator::visit(
     }
     code_->addLine("}");
   } else {
-    // TODO(ES): support look-ahead switch
+    emitLookAheadSwitch(node);
   }
 }
 
@@ -294,19 +322,75 @@ void ParserGenerator::visit(node_ptr<spec::ast::type::Bool> node) {
 
 void ParserGenerator::visit(node_ptr<spec::ast::type::Bytes> node) {
   auto item = current<ast::type::unit::item::Item>();
-  if (item->attributes()->has("length")) {
+  size_t fixed_length;
+  if (item->attributes()->has("file")) {
+    if (!item->attributes()->has("length")) {
+      log(pantheios::error, item, "&file fields require a &length");
+      return;
+    }
+
+    // received values are stored like var_bytes, with an fd_ of -1. only the
+    // application sets file ranges, for units it serializes.
+    auto length = item->attributes()->lookup("length")->value();
+    code_->addLine(
+        util::fmt("(*((dr::unit::file_range*) parse_dest)).len_ = %s;",
+                  translator_.expression(length)));
+    code_->addLine("(*((dr::unit::file_range*) parse_dest)).fd_ = -1;");
+    code_->addLine("(*((dr::unit::file_range*) parse_dest)).offset_ = 0;");
+    if (use_input_pointer_) {
+      code_->addLine("(*((dr::unit::file_range*) parse_dest)).data_ = *POS;");
+      code_->addLine(
+          "parse_res = dr::parsing::util::advance(POS, in_buf_end, "
+          "(*((dr::unit::file_range*) parse_dest)).len_);");
+    } else {
+      bool carved = carved_items_.count(item.get());
+      code_->addLine(util::fmt(
+          "parse_res = dr::parsing::util::%sBytes("
+          "POS, in_buf_end, &(*((dr::unit::file_range*) parse_dest)).data_, "
+          "(*((dr::unit::file_range*) parse_dest)).len_, %s);",
+          carved ? "carveCopy" : "allocateCopy",
+          carved ? "&BLOCKSTATE->var_pos" : "area"));
+    }
+    emitCheckParseResult();
+  } else if (!use_input_pointer_ &&
+             translator_.fixedBytesLength(item, &fixed_length)) {
+    // stored inline, no allocation needed
+    code_->addLine(util::fmt(
+        "parse_res = dr::parsing::util::copyFixedBytes<%d>(POS, in_buf_end, "
+        "parse_dest);",
+        fixed_length));
+    emitCheckParseResult();
+  } else if (item->attributes()->has("length")) {
     // TODO(ES): support incremental copy of byte fields
     // only if "chunked" attr is given?
     auto length = item->attributes()->lookup("length")->value();
     auto length_str = translator_.expression(length);
 
+    // var_bytes, or rel_bytes in relative offsets mode
+    auto bytes_type = translator_.type(node);
+    std::string inline_type;
     if (!use_input_pointer_) {
+      code_->addLine(util::fmt("(*((%s*) parse_dest)).len_ = %s;", bytes_type,
+                               length_str));
+    }
+
+    // copy into space allocated up front, or allocate from the area
+    bool carved = carved_items_.count(item.get());
+    std::string copy = carved ? "carveCopy" : "allocateCopy";
+    std::string area = carved ? "&BLOCKSTATE->var_pos" : "area";
+    if (!use_input_pointer_ &&
+        translator_.inlineBytesType(item, &inline_type)) {
+      // short values are stored inline, long ones spill to the area
       code_->addLine(util::fmt(
-          "(*((dr::unit::var_bytes*) parse_dest)).len_ = %s;", length_str));
-      code_->addLine(
-          "parse_res = dr::parsing::util::allocateCopyBytes("
-          "POS, in_buf_end, &(*((dr::unit::var_bytes*) parse_dest)).data_, "
-          "(*((dr::unit::var_bytes*) parse_dest)).len_, area);");
+          "parse_res = dr::parsing::util::%sInlineBytes("
+          "POS, in_buf_end, (%s*) parse_dest, %s);",
+          copy, inline_type, area));
+    } else if (!use_input_pointer_) {
+      code_->addLine(util::fmt(
+          "parse_res = dr::parsing::util::%sBytes("
+          "POS, in_buf_end, &(*((%s*) parse_dest)).data_, "
+          "(*((%s*) parse_dest)).len_, %s);",
+          copy, bytes_type, bytes_type, area));
     } else {
       code_->addLine(
           util::fmt("(*((dr::unit::var_stream_range*) parse_dest)).len_ = %s;",
@@ -370,12 +454,26 @@ void ParserGenerator::visit(node_ptr<spec::ast::type::String> node) {
     auto length = item->attributes()->lookup("length")->value();
     auto length_str = translator_.expression(length);
     // TODO(ES): assuming ascii here, what about other encodings?
-    code_->addLine(util::fmt(
-        "(*((dr::unit::var_string*) parse_dest)).len_ = %s;", length_str));
-    code_->addLine(
-        "parse_res = dr::parsing::util::allocateCopyBytes("
-        "POS, in_buf_end, &(*((dr::unit::var_string*) parse_dest)).data_, "
-        "(*((dr::unit::var_string*) parse_dest)).len_, area);");
+    auto string_type = translator_.type(node);
+    code_->addLine(util::fmt("(*((%s*) parse_dest)).len_ = %s;", string_type,
+                             length_str));
+    std::string inline_type;
+    bool carved = carved_items_.count(item.get());
+    std::string copy = carved ? "carveCopy" : "allocateCopy";
+    std::string area = carved ? "&BLOCKSTATE->var_pos" : "area";
+    if (translator_.inlineBytesType(item, &inline_type)) {
+      // short values are stored inline, long ones spill to the area
+      code_->addLine(util::fmt(
+          "parse_res = dr::parsing::util::%sInlineBytes("
+          "POS, in_buf_end, (%s*) parse_dest, %s);",
+          copy, inline_type, area));
+    } else {
+      code_->addLine(util::fmt(
+          "parse_res = dr::parsing::util::%sBytes("
+          "POS, in_buf_end, &(*((%s*) parse_dest)).data_, "
+          "(*((%s*) parse_dest)).len_, %s);",
+          copy, string_type, string_type, area));
+    }
     emitCheckParseResult();
   } else {
     // TODO(ES): support "until" and eod parsing of strings
@@ -413,6 +511,8 @@ void ParserGenerator::visit(
 }
 
 void ParserGenerator::parse(node_ptr<ast::type::unit::item::Item> item) {
+  if (alloc_item_ && item.get() == alloc_item_.get()) emitMessageAllocation();
+
   std::string instr_label = newInstructionLabel(
       util::fmt("parse_%s_%s", unit_->id()->name(), item->id()->name()));
 
@@ -424,7 +524,19 @@ void ParserGenerator::parse(node_ptr<ast::type::unit::item::Item> item) {
   code_ = &instr;
 
   emitInitInstruction(instr_label);
-  processOne(item);
+  if (item->attributes()->has("patchable")) {
+    // relative to the message start, so the input can be moved before patching
+    code_->addLine(util::fmt(
+        "%s->%s = static_cast<uint32_t>(*POS - in_buf_start);",
+        exprCurrentUnit(), translator_.unitWireOffsetName(item->id()->name())));
+  }
+  if (ast::tryCast<ast::type::unit::item::field::Field>(item) &&
+      item->attributes()->has("transform")) {
+    // transforms decode directly from the stream into the field.
+    emitTransformDecode(item);
+  } else {
+    processOne(item);
+  }
 
   item_ = item_tmp;
   code_ = code_tmp;
@@ -433,12 +545,113 @@ void ParserGenerator::parse(node_ptr<ast::type::unit::item::Item> item) {
   code_->addBlock(instr);
 }
 
+void ParserGenerator::clearMessageAllocation() {
+  alloc_item_ = nullptr;
+  alloc_sizes_.clear();
+  carved_items_.clear();
+}
+
+bool ParserGenerator::planMessageAllocation() {
+  clearMessageAllocation();
+
+  // the unit and all its area allocations can be done at once if the lengths
+  // of the allocating fields only depend on items parsed before the first one
+  // of them, e.g. a header with length fields followed by the payloads.
+  std::set<std::string> parsed;
+  for (auto item : unit_->items()) {
+    if (ast::tryCast<ast::type::unit::item::Property>(item)) continue;
+
+    std::string size;
+    if (areaAllocationSize(item, &size)) {
+      auto length = item->attributes()->lookup("length")->value();
+      auto nodes = length->children(true);
+      nodes.push_back(length);
+      for (auto n : nodes) {
+        auto member = ast::tryCast<ast::expression::MemberAttribute>(n);
+        if (member && !parsed.count(member->attribute()->name())) {
+          clearMessageAllocation();
+          return false;
+        }
+      }
+      if (!alloc_item_) alloc_item_ = item;
+      alloc_sizes_.push_back(size);
+      carved_items_.insert(item.get());
+    } else if (allocatesFromArea(item)) {
+      // TODO(ES): support allocations within switches
+      clearMessageAllocation();
+      return false;
+    }
+
+    if (!alloc_item_) parsed.insert(item->id()->name());
+  }
+
+  return static_cast<bool>(alloc_item_);
+}
+
+bool ParserGenerator::areaAllocationSize(
+    node_ptr<ast::type::unit::item::Item> item, std::string* size) {
+  // mirrors the allocations of visit(Bytes) and visit(String)
+  if (!ast::isA<ast::type::unit::item::field::AtomicType>(item)) return false;
+  bool string = ast::isA<ast::type::String>(item->type());
+  if (!string && !ast::isA<ast::type::Bytes>(item->type())) return false;
+  if (!item->attributes()->has("length") ||
+      item->attributes()->has("transform"))
+    return false;
+
+  // received values of &file fields are never stored inline
+  bool file = item->attributes()->has("file");
+  size_t fixed_length;
+  bool input_pointer =
+      !item->application_accessible() && options_->input_pointers;
+  if (!string &&
+      (input_pointer ||
+       (!file && translator_.fixedBytesLength(item, &fixed_length))))
+    return false;
+
+  auto length = translator_.expression(
+      item->attributes()->lookup("length")->value());
+  std::string inline_type;
+  size_t capacity;
+  if (!file && translator_.inlineBytesType(item, &inline_type, &capacity)) {
+    // only values exceeding the inline capacity are allocated
+    *size = util::fmt("(%s > %d ? %s : 0)", length, capacity, length);
+  } else {
+    *size = util::fmt("(%s)", length);
+  }
+  return true;
+}
+
+bool ParserGenerator::allocatesFromArea(
+    node_ptr<ast::type::unit::item::Item> item) {
+  std::string size;
+  if (areaAllocationSize(item, &size)) return true;
+
+  if (auto sw =
+          ast::tryCast<ast::type::unit::item::field::switch_::Switch>(item)) {
+    for (auto c : sw->cases()) {
+      for (auto i : c->items()) {
+        if (allocatesFromArea(i)) return true;
+      }
+    }
+  }
+  return false;
+}
+
 std::string ParserGenerator::addTemp(std::string type) {
   auto name = newTempVarName();
   temp_vars_.push_back(std::make_pair(name, type));
   return name;
 }
 
+std::string ParserGenerator::addConstant(const std::string& bytes) {
+  for (auto c : consts_) {
+    if (c.second == bytes) return c.first;
+  }
+  auto name = util::fmt("const%i", consts_.size() + 1);
+  consts_.push_back(std::make_pair(name, bytes));
+  return name;
+}
+
 void ParserGenerator::emitInitInstruction(const std::string& instr_label) {
   code_->addLine(instr_label + ":");
   code_->addLine(util::fmt("state->advanceToInstruction(&&%s);", instr_label));
@@ -460,6 +673,184 @@ void ParserGenerator::emitCheckParseResult() {
   code_->addLine("  return parse_res;");
 }
 
+void ParserGenerator::emitTransformDecode(
+    node_ptr<ast::type::unit::item::Item> item) {
+  auto attr = item->attributes()->lookup("transform");
+  auto transform = ast::tryCast<ast::expression::Transform>(attr->value());
+  if (!transform) {
+    log(pantheios::error, item, "unresolved transform");
+    return;
+  }
+
+  code_->addLine(util::fmt("parse_dest = (char*) &%s->%s;", exprCurrentUnit(),
+                           translator_.unitFieldName(item->id()->name())));
+  code_->addLine(util::fmt(
+      "parse_res = %s::decode(POS, in_buf_end, parse_dest);",
+      translator_.transformName(transform->transform()->id()->name())));
+  emitCheckParseResult();
+}
+
+void ParserGenerator::emitLookAheadSwitch(
+    node_ptr<ast::type::unit::item::field::switch_::Switch> node) {
+  // dispatch on the first input bytes via tables built from the prefixes of
+  // each case's fields, instead of trying each alternative in turn.
+  std::vector<look_ahead::Prefix> prefixes;
+  std::vector<node_ptr<ast::type::unit::item::field::switch_::Case>> cases;
+  std::vector<size_t> indices;
+  node_ptr<ast::type::unit::item::field::switch_::Case> default_case = nullptr;
+  size_t default_index = 0, index = 0;
+  for (auto c : node->cases()) {
+    ++index;
+    if (c->_default()) {
+      default_case = c;
+      default_index = index;
+      continue;
+    }
+    prefixes.push_back(casePrefix(c->items()));
+    cases.push_back(c);
+    indices.push_back(index);
+  }
+
+  if (cases.size() > look_ahead::Table::kMaxCases) {
+    log(pantheios::error, node, "too many cases for look-ahead switch");
+    return;
+  }
+
+  auto table = look_ahead::buildTable(prefixes);
+  for (auto c : table.ambiguous) {
+    log(pantheios::warning, cases[c - 1],
+        "look-ahead is ambiguous with an earlier case for some inputs");
+  }
+
+  auto lookahead = addTemp("uint8_t");
+  code_->addLine("if (in_buf_end - *POS < 1)");
+  code_->addLine("  return dr::parsing::ParseResult::OUT_OF_DATA;");
+  code_->addLine(util::fmt("%s = ParserConstants::%s[(uint8_t) (*POS)[0]];",
+                           lookahead, addConstant(table.first)));
+  if (!table.second.empty()) {
+    code_->addLine(util::fmt("if (%s & 0x%02x) {", lookahead,
+                             look_ahead::Table::kSecondLevel));
+    code_->addLine("  if (in_buf_end - *POS < 2)");
+    code_->addLine("    return dr::parsing::ParseResult::OUT_OF_DATA;");
+    code_->addLine(util::fmt(
+        "  %s = ParserConstants::%s[(%s & 0x%02x) * 256 + "
+        "(uint8_t) (*POS)[1]];",
+        lookahead, addConstant(table.second), lookahead,
+        look_ahead::Table::kMaxCases));
+    code_->addLine("}");
+  }
+
+  code_->addLine(util::fmt("switch (%s) {", lookahead));
+  for (size_t i = 0; i < cases.size(); i++) {
+    code_->addLine(util::fmt("case %d:", i + 1));
+    code_->indent();
+    emitSwitchCase(node, indices[i]);
+    for (auto x : cases[i]->items()) {
+      parse(x);
+    }
+    code_->addLine("break;");
+    code_->unindent();
+  }
+  code_->addLine("default:");
+  code_->indent();
+  if (default_case) {
+    emitSwitchCase(node, default_index);
+    for (auto x : default_case->items()) {
+      parse(x);
+    }
+    code_->addLine("break;");
+  } else {
+    code_->addLine("return dr::parsing::ParseResult::INVALID_INPUT;");
+  }
+  code_->unindent();
+  code_->addLine("}");
+}
+
+void ParserGenerator::emitSwitchCase(
+    node_ptr<ast::type::unit::item::field::switch_::Switch> node,
+    size_t index) {
+  // record which case's fields are set in the switch's union
+  code_->addLine(util::fmt("%s->%s = %d;", exprCurrentUnit(),
+                           translator_.unitSwitchCaseName(node),
+                           index));
+}
+
+look_ahead::Prefix ParserGenerator::casePrefix(
+    const spec::ast::unit_field_list& items) {
+  // fields of known bytes that are shorter than the look-ahead depth are
+  // followed by the prefix of the next field
+  auto prefix = look_ahead::anyPrefix();
+  size_t pos = 0;
+  for (auto field : items) {
+    if (pos == look_ahead::kDepth) break;
+    std::string bytes;
+    if (fieldBytes(field, &bytes)) {
+      for (size_t k = 0; k < bytes.size() && pos < look_ahead::kDepth; k++) {
+        prefix[pos].reset();
+        prefix[pos++].set(static_cast<unsigned char>(bytes[k]));
+      }
+      continue;
+    }
+    auto next = fieldPrefix(field);
+    for (size_t k = 0; pos + k < look_ahead::kDepth; k++)
+      prefix[pos + k] = next[k];
+    break;
+  }
+  return prefix;
+}
+
+bool ParserGenerator::fieldBytes(
+    node_ptr<ast::type::unit::item::field::Field> field, std::string* bytes) {
+  namespace item = ast::type::unit::item;
+
+  if (field->condition()) return false;
+  if (auto constant = ast::tryCast<item::field::Constant>(field))
+    return serializedConstant(constant, bytes);
+  if (auto ctor = ast::tryCast<item::field::Ctor>(field)) {
+    if (auto b = ast::tryCast<ast::ctor::Bytes>(ctor->ctor())) {
+      *bytes = b->value();
+      return true;
+    }
+  }
+  return false;
+}
+
+look_ahead::Prefix ParserGenerator::fieldPrefix(
+    node_ptr<ast::type::unit::item::field::Field> field) {
+  namespace item = ast::type::unit::item;
+
+  if (field->condition()) return look_ahead::anyPrefix();
+
+  std::string bytes;
+  if (fieldBytes(field, &bytes)) {
+    return look_ahead::bytesPrefix(bytes);
+  } else if (auto ctor = ast::tryCast<item::field::Ctor>(field)) {
+    if (auto regexp = ast::tryCast<ast::ctor::RegExp>(ctor->ctor())) {
+      return look_ahead::regExpPrefix(regexp->patterns());
+    }
+  } else if (auto unit_field = ast::tryCast<item::field::Unit>(field)) {
+    // use the first field of embedded units
+    auto unit = ast::tryCast<ast::type::unit::Unit>(unit_field->type());
+    if (unit && unit != unit_) {
+      for (auto i : unit->items()) {
+        if (auto f = ast::tryCast<item::field::Field>(i))
+          return fieldPrefix(f);
+      }
+    }
+  }
+
+  return look_ahead::anyPrefix();
+}
+
+bool ParserGenerator::serializedConstant(
+    node_ptr<ast::type::unit::item::field::Constant> field,
+    std::string* bytes) {
+  bool big_endian = true;
+  if (auto int_type = translator_.constantIntegerType(field->constant()))
+    big_endian = byteOrderLabel(int_type) == "big";
+  return translator_.serializedConstant(field->constant(), big_endian, bytes);
+}
+
 void ParserGenerator::emitPushBlockState() {
   code_->addLine("state->push<BlockState>();");
   // TODO(ES): initialization of block state members?
@@ -467,6 +858,22 @@ void ParserGenerator::emitPushBlockState() {
   code_->newLine();
 }
 
+void ParserGenerator::emitMessageAllocation() {
+  // allocate the unit (placed at the area's next position at the root
+  // instruction) together with the space for all variable-length fields
+  emitInitInstruction(
+      newInstructionLabel(util::fmt("allocate_%s", unit_->id()->name())));
+
+  auto unit_type = translator_.type(unit_);
+  std::string size = util::fmt("sizeof(%s)", unit_type);
+  for (const auto& s : alloc_sizes_) size += " + " + s;
+  code_->addLine(
+      util::fmt("if (!area->allocate(%s, &BLOCKSTATE->var_pos))", size));
+  code_->addLine("  return dr::parsing::ParseResult::AREA_FULL;");
+  code_->addLine(util::fmt("BLOCKSTATE->var_pos += sizeof(%s);", unit_type));
+  code_->newLine();
+}
+
 std::string ParserGenerator::newInstructionLabel(std::string label_desc) {
   return util::fmt("lbl%i_%s", ++lastLabelId_, label_desc);
 }
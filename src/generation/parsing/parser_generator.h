@@ -31,10 +31,12 @@
 #include <kode/code.h>
 #include <kode/membervariable.h>
 #include <list>
+#include <set>
 #include <string>
 #include <utility>
 
 #include "generation/output/translator.h"
+#include "generation/parsing/look_ahead.h"
 #include "spec/ast/node.h"
 #include "spec/ast/type/atomic_types.h"
 #include "spec/ast/type/bitfield.h"
@@ -103,8 +105,7 @@ class ParserGenerator : public spec::ast::Visitor<> {
  private:
   KODE::Class* cls_ = nullptr;
   KODE::Code* code_ = nullptr;
-  KODE::Code* init_consts_code_ = nullptr;
-  std::list<KODE::MemberVariable> consts_;
+  std::list<std::pair<std::string, std::string>> consts_;
   std::list<std::pair<std::string, std::string>> temp_vars_;
   std::string root_instr_;
 
@@ -118,15 +119,44 @@ class ParserGenerator : public spec::ast::Visitor<> {
   bool use_input_pointer_ = false;
   const Options* options_ = nullptr;
 
+  // first item that allocates from the area, if the unit and all its area
+  // allocations are done at once before it (see planMessageAllocation)
+  node_ptr<spec::ast::type::unit::item::Item> alloc_item_ = nullptr;
+  std::list<std::string> alloc_sizes_;
+  std::set<spec::ast::Node*> carved_items_;
+
   void parse(node_ptr<spec::ast::type::unit::item::Item> item);
 
+  bool planMessageAllocation();
+  void clearMessageAllocation();
+  bool areaAllocationSize(node_ptr<spec::ast::type::unit::item::Item> item,
+                          std::string* size);
+  bool allocatesFromArea(node_ptr<spec::ast::type::unit::item::Item> item);
+
   std::string addTemp(std::string type);
+  std::string addConstant(const std::string& bytes);
 
   void emitInitInstruction(const std::string& instr_label);
   void emitAllocateIntoPointer(const std::string& pointer);
   void emitAllocateIntoPointerPointer(const std::string& pointer);
   void emitCheckParseResult();
+  void emitTransformDecode(node_ptr<spec::ast::type::unit::item::Item> item);
   void emitPushBlockState();
+  void emitMessageAllocation();
+  void emitLookAheadSwitch(
+      node_ptr<spec::ast::type::unit::item::field::switch_::Switch> node);
+  void emitSwitchCase(
+      node_ptr<spec::ast::type::unit::item::field::switch_::Switch> node,
+      size_t index);
+
+  look_ahead::Prefix casePrefix(const spec::ast::unit_field_list& items);
+  look_ahead::Prefix fieldPrefix(
+      node_ptr<spec::ast::type::unit::item::field::Field> field);
+  bool fieldBytes(node_ptr<spec::ast::type::unit::item::field::Field> field,
+                  std::string* bytes);
+  bool serializedConstant(
+      node_ptr<spec::ast::type::unit::item::field::Constant> field,
+      std::string* bytes);
 
   std::string newInstructionLabel(std::string label_desc = std::string());
   std::string newTempVarName();
@@ -79,10 +79,10 @@ void SelfReplacerVisitor::visit(
       processOne(c);
     } else if (auto m = ast::tryCast<ast::AttributeMap>(c)) {
       for (auto a : m->attributes()) {
-        processOne(a->value());
+        if (a->value()) processOne(a->value());
       }
     } else if (auto a = ast::tryCast<ast::Attribute>(c)) {
-      processOne(a->value());
+      if (a->value()) processOne(a->value());
     }
   }
 }
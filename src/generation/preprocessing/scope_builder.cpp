@@ -199,6 +199,20 @@ void ScopeBuilder::addBuiltins(node_ptr<spec::ast::Module> module) {
       ast::newNodePtr(std::make_shared<ast::declaration::Transform>(
           seui32_transform, ast::declaration::Declaration::Linkage::IMPORTED));
   module->addDeclaration(seui32_decl);
+
+  // hexStringEncodedUint32 transform
+  auto hseui32_id =
+      ast::newNodePtr(std::make_shared<ast::ID>("hexStringEncodedUint32"));
+  auto hseui32_wire_type =
+      ast::newNodePtr(std::make_shared<ast::type::String>());
+  auto hseui32_internal_type =
+      ast::newNodePtr(std::make_shared<ast::type::Integer>(32, false));
+  auto hseui32_transform = ast::newNodePtr(std::make_shared<ast::Transform>(
+      hseui32_id, hseui32_wire_type, hseui32_internal_type, nullptr, nullptr));
+  auto hseui32_decl =
+      ast::newNodePtr(std::make_shared<ast::declaration::Transform>(
+          hseui32_transform, ast::declaration::Declaration::Linkage::IMPORTED));
+  module->addDeclaration(hseui32_decl);
 }
 
 }  // namespace preprocessing
@@ -31,9 +31,11 @@
 
 #include "spec/ast/attribute.h"
 #include "spec/ast/expression/id.h"
+#include "spec/ast/expression/transform.h"
 #include "spec/ast/expression/type.h"
 #include "spec/ast/module.h"
 #include "spec/ast/node.h"
+#include "spec/ast/transform.h"
 #include "spec/ast/type/atomic_types.h"
 #include "spec/ast/type/unit.h"
 #include "spec/ast/visitor.h"
@@ -78,7 +80,27 @@ void TransformResolver::visit(
 
     node->set_type(type);
   } else if (node->attributes()->has("transform")) {
+    auto attr = node->attributes()->lookup("transform");
+    auto transform_expr =
+        ast::tryCast<ast::expression::Transform>(attr->value());
+    if (!transform_expr) {
+      log(pantheios::error, attr,
+          "expected transform as value of transform attribute");
+      return;
+    }
+
     // TODO(ES): support custom transform functions
+    auto transform = transform_expr->transform();
+    if (transform->decode() || transform->encode()) {
+      log(pantheios::error, attr,
+          "custom transform functions are not supported yet");
+      return;
+    }
+
+    // built-in transforms are implemented by the runtime and decode directly
+    // from the wire into their internal type.
+    node->set_serialized_type(node->type());
+    node->set_type(transform->internal_type());
   }
 }
 
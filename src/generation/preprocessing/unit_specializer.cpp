@@ -0,0 +1,400 @@
+/*
+ * unit_specializer.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "generation/preprocessing/unit_specializer.h"
+
+#include <pantheios/pantheios.hpp>
+#include <cctype>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "spec/ast/attribute.h"
+#include "spec/ast/constant/bool.h"
+#include "spec/ast/constant/enum.h"
+#include "spec/ast/constant/integer.h"
+#include "spec/ast/declaration/declaration.h"
+#include "spec/ast/declaration/type.h"
+#include "spec/ast/expression/conditional.h"
+#include "spec/ast/expression/constant.h"
+#include "spec/ast/expression/operator.h"
+#include "spec/ast/expression/parser_state.h"
+#include "spec/ast/id.h"
+#include "spec/ast/module.h"
+#include "spec/ast/node.h"
+#include "spec/ast/scope.h"
+#include "spec/ast/type/unit.h"
+#include "spec/ast/visitor.h"
+#include "util/util.h"
+
+namespace ast = diffingo::spec::ast;
+
+namespace diffingo {
+namespace generation {
+namespace preprocessing {
+
+namespace {
+
+// Returns 1 or 0 if the constant is a boolean true or false, -1 otherwise.
+int truth(node_ptr<ast::constant::Constant> constant) {
+  auto b = ast::tryCast<ast::constant::Bool>(constant);
+  if (!b) return -1;
+  return b->value() ? 1 : 0;
+}
+
+// Compares two constants of the same kind. Returns false if they aren't
+// comparable.
+bool compare(node_ptr<ast::constant::Constant> a,
+             node_ptr<ast::constant::Constant> b, bool* equal) {
+  if (auto ba = ast::tryCast<ast::constant::Bool>(a)) {
+    auto bb = ast::tryCast<ast::constant::Bool>(b);
+    if (!bb) return false;
+    *equal = ba->value() == bb->value();
+    return true;
+  } else if (auto ia = ast::tryCast<ast::constant::Integer>(a)) {
+    auto ib = ast::tryCast<ast::constant::Integer>(b);
+    if (!ib) return false;
+    *equal = ia->value() == ib->value();
+    return true;
+  } else if (auto ea = ast::tryCast<ast::constant::Enum>(a)) {
+    auto eb = ast::tryCast<ast::constant::Enum>(b);
+    if (!eb) return false;
+    *equal = ea->label()->name() == eb->label()->name();
+    return true;
+  }
+  return false;
+}
+
+node_ptr<ast::constant::Constant> boolConstant(bool value) {
+  return ast::newNodePtr(std::make_shared<ast::constant::Bool>(value));
+}
+
+// Returns a name for a constant argument that can be part of an identifier.
+std::string argumentName(node_ptr<ast::constant::Constant> constant) {
+  std::string name;
+  if (auto b = ast::tryCast<ast::constant::Bool>(constant)) {
+    name = b->value() ? "True" : "False";
+  } else if (auto i = ast::tryCast<ast::constant::Integer>(constant)) {
+    name = i->valueAsString();
+  } else if (auto e = ast::tryCast<ast::constant::Enum>(constant)) {
+    name = e->label()->name();
+  } else {
+    name = "Const";
+  }
+
+  for (auto& c : name) {
+    if (!std::isalnum(static_cast<unsigned char>(c))) c = '_';
+  }
+  return name;
+}
+
+}  // namespace
+
+ParameterReplacerVisitor::ParameterReplacerVisitor() {}
+
+ParameterReplacerVisitor::~ParameterReplacerVisitor() {}
+
+bool ParameterReplacerVisitor::run(
+    node_ptr<spec::ast::type::unit::item::Item> item,
+    node_ptr<spec::ast::type::unit::Unit> unit,
+    const std::map<std::string, node_ptr<spec::ast::expression::Expression>>&
+        args) {
+  unit_ = unit;
+  args_ = &args;
+  return processOne(item);
+}
+
+void ParameterReplacerVisitor::visit(
+    node_ptr<spec::ast::type::unit::item::Item> node) {
+  for (auto c : node->children(false)) {
+    if (ast::tryCast<ast::expression::Expression>(c) ||
+        ast::tryCast<ast::type::unit::item::field::switch_::Case>(c)) {
+      processOne(c);
+    } else if (auto m = ast::tryCast<ast::AttributeMap>(c)) {
+      for (auto a : m->attributes()) {
+        processOne(a->value());
+      }
+    }
+  }
+
+  // conditions aren't children of their fields
+  auto field = ast::tryCast<ast::type::unit::item::field::Field>(node);
+  if (field && field->condition()) processOne(field->condition());
+}
+
+void ParameterReplacerVisitor::visit(
+    node_ptr<spec::ast::type::unit::item::field::switch_::Case> node) {
+  for (auto e : node->expressions()) {
+    processOne(e);
+  }
+  for (auto i : node->items()) {
+    processOne(i);
+  }
+}
+
+void ParameterReplacerVisitor::visit(
+    node_ptr<spec::ast::expression::Expression> node) {
+  for (auto c : node->children(false)) {
+    if (ast::tryCast<ast::expression::Expression>(c)) {
+      processOne(c);
+    }
+  }
+}
+
+void ParameterReplacerVisitor::visit(
+    node_ptr<spec::ast::expression::ParserState> node) {
+  if (node->kind() != ast::expression::ParserState::PARAMETER) return;
+  if (node->unit().get() != unit_.get()) return;
+
+  auto arg = args_->find(node->id()->name());
+  if (arg != args_->end()) node.replace(arg->second->clone());
+}
+
+UnitSpecializer::UnitSpecializer() {}
+
+UnitSpecializer::~UnitSpecializer() {}
+
+bool UnitSpecializer::run(node_ptr<spec::ast::Module> node,
+                          const Options& options) {
+  module_ = node;
+
+  for (auto d : node->declarations()) {
+    auto decl = ast::tryCast<ast::declaration::Type>(d);
+    if (!decl) continue;
+    if (auto unit = ast::tryCast<ast::type::unit::Unit>(decl->type())) {
+      decls_[unit.get()] = decl;
+      pending_.push_back(unit);
+    }
+  }
+
+  // specialized units may embed further units with constant arguments
+  while (!pending_.empty()) {
+    auto unit = pending_.front();
+    pending_.pop_front();
+    specializeFields(unit);
+  }
+
+  return !errors();
+}
+
+void UnitSpecializer::specializeFields(
+    node_ptr<spec::ast::type::unit::Unit> unit) {
+  // TODO(ES): also specialize units embedded as elements of containers
+  for (auto item : unit->flattenedItems()) {
+    auto field = ast::tryCast<ast::type::unit::item::field::Unit>(item);
+    if (!field) continue;
+
+    auto target = ast::tryCast<ast::type::unit::Unit>(field->type());
+    if (!target || target->parameters().empty()) continue;
+
+    auto decl = decls_.find(target.get());
+    if (decl == decls_.end()) continue;
+
+    auto params = field->parameters();
+    if (params.size() != target->parameters().size()) {
+      log(pantheios::error, field,
+          util::fmt("unit %s expects %d parameters", decl->second->id()->name(),
+                    target->parameters().size()));
+      continue;
+    }
+
+    // bind constant arguments, keep the others as runtime parameters
+    std::map<std::string, node_ptr<ast::expression::Expression>> args;
+    ast::parameter_list dynamic_params;
+    ast::expression_list dynamic_args;
+    std::string name = decl->second->id()->name();
+    auto arg = params.begin();
+    for (auto p : target->parameters()) {
+      if (auto value = fold(*arg)) {
+        args[p->id()->name()] = ast::newNodePtr(
+            std::make_shared<ast::expression::Constant>(value));
+        name += "_" + argumentName(value);
+      } else {
+        dynamic_params.push_back(p);
+        dynamic_args.push_back(*arg);
+        name += "_Any";
+      }
+      ++arg;
+    }
+    if (args.empty()) continue;
+
+    auto& spec = specializations_[name];
+    if (!spec) spec = specialize(decl->second, name, args, dynamic_params);
+
+    auto nfield = ast::type::unit::item::field::Field::createByType(
+        spec->type(), field->id(), field->condition(),
+        field->attributes()->attributes(), dynamic_args, field->sinks(),
+        field->location());
+    nfield->scope()->set_parent(field->scope()->parent());
+    if (field->anonymous()) nfield->set_anonymous();
+    nfield->set_unit(field->unit().get());
+
+    item.replace(nfield);
+  }
+}
+
+node_ptr<spec::ast::declaration::Type> UnitSpecializer::specialize(
+    node_ptr<spec::ast::declaration::Type> decl, const std::string& name,
+    const std::map<std::string, node_ptr<spec::ast::expression::Expression>>&
+        args,
+    const spec::ast::parameter_list& dynamic_params) {
+  auto unit = ast::checkedCast<ast::type::unit::Unit>(decl->type());
+
+  ast::unit_item_list items;
+  for (auto i : unit->items()) {
+    auto item = i->clone();
+    param_replacer_.run(item, unit, args);
+    items.push_back(item);
+  }
+
+  auto spec = ast::newNodePtr(std::make_shared<ast::type::unit::Unit>(
+      dynamic_params, foldItems(items), unit->location()));
+  auto id = ast::newNodePtr(
+      std::make_shared<ast::ID>(name, decl->id()->location()));
+  spec->set_id(id);
+  spec->set_scope(unit->scope());
+  spec->typeScope()->set_parent(unit->typeScope());
+  self_replacer_.run(spec, spec);
+
+  auto spec_decl = ast::newNodePtr(
+      std::make_shared<ast::declaration::Type>(id, decl->linkage(), spec));
+  module_->addDeclaration(spec_decl);
+
+  log(pantheios::informational, decl,
+      util::fmt("specialized unit %s as %s", decl->id()->name(), name));
+
+  decls_[spec.get()] = spec_decl;
+  pending_.push_back(spec);
+  return spec_decl;
+}
+
+spec::ast::unit_item_list UnitSpecializer::foldItems(
+    const spec::ast::unit_item_list& items) {
+  namespace item = ast::type::unit::item;
+
+  ast::unit_item_list result;
+  for (auto i : items) {
+    auto field = ast::tryCast<item::field::Field>(i);
+    if (field && field->condition()) {
+      auto present = truth(fold(field->condition()));
+      if (present == 0) continue;
+      if (present == 1) field->set_condition(nullptr);
+    }
+
+    // only the matching case of a switch on a constant can ever be taken
+    auto switch_ = ast::tryCast<item::field::switch_::Switch>(i);
+    node_ptr<ast::constant::Constant> value = nullptr;
+    if (switch_ && !switch_->condition()) value = fold(switch_->expression());
+    if (!value) {
+      result.push_back(i);
+      continue;
+    }
+
+    node_ptr<item::field::switch_::Case> match = nullptr;
+    bool decidable = true;
+    for (auto c : switch_->cases()) {
+      if (c->_default()) {
+        if (!match) match = c;
+        continue;
+      }
+      for (auto e : c->expressions()) {
+        bool equal = false;
+        auto label = fold(e);
+        if (!label || !compare(value, label, &equal)) {
+          decidable = false;
+        } else if (equal && (!match || match->_default())) {
+          match = c;
+        }
+      }
+    }
+
+    if (!decidable) {
+      result.push_back(i);
+    } else if (!match) {
+      // keep the switch, so that the unit is parsed and serialized like the
+      // unspecialized one
+      log(pantheios::warning, switch_,
+          "no case matches the constant switch expression");
+      result.push_back(i);
+    } else {
+      ast::unit_item_list case_items;
+      for (auto f : match->items()) case_items.push_back(f);
+      for (auto f : foldItems(case_items)) result.push_back(f);
+    }
+  }
+  return result;
+}
+
+node_ptr<spec::ast::constant::Constant> UnitSpecializer::fold(
+    node_ptr<spec::ast::expression::Expression> expr) {
+  namespace expression = ast::expression;
+
+  if (!expr) return nullptr;
+
+  if (auto c = ast::tryCast<expression::Constant>(expr)) return c->constant();
+
+  if (auto cond = ast::tryCast<expression::Conditional>(expr)) {
+    auto t = truth(fold(cond->cond()));
+    if (t < 0) return nullptr;
+    return fold(t ? cond->_true() : cond->_false());
+  }
+
+  auto op = ast::tryCast<expression::Operator>(expr);
+  if (!op) return nullptr;
+
+  auto ops = op->operands();
+  switch (op->kind()) {
+    case expression::Operator::Kind::Not: {
+      auto t = truth(fold(ops.front()));
+      return t < 0 ? nullptr : boolConstant(!t);
+    }
+    case expression::Operator::Kind::LogicalAnd:
+    case expression::Operator::Kind::LogicalOr: {
+      // short-circuits, so that a single constant operand may suffice
+      bool is_and = op->kind() == expression::Operator::Kind::LogicalAnd;
+      auto a = truth(fold(ops.front()));
+      auto b = truth(fold(ops.back()));
+      if (a == !is_and || b == !is_and) return boolConstant(!is_and);
+      if (a < 0 || b < 0) return nullptr;
+      return boolConstant(is_and);
+    }
+    case expression::Operator::Kind::Equal: {
+      auto a = fold(ops.front());
+      auto b = fold(ops.back());
+      bool equal = false;
+      if (!a || !b || !compare(a, b, &equal)) return nullptr;
+      return boolConstant(equal);
+    }
+    default:
+      return nullptr;
+  }
+}
+
+}  // namespace preprocessing
+}  // namespace generation
+}  // namespace diffingo
@@ -0,0 +1,122 @@
+/*
+ * unit_specializer.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef SRC_GENERATION_PREPROCESSING_UNIT_SPECIALIZER_H_
+#define SRC_GENERATION_PREPROCESSING_UNIT_SPECIALIZER_H_
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "generation/pass.h"
+#include "generation/preprocessing/instantiation_type_generator.h"
+#include "spec/ast/constant/constant.h"
+#include "spec/ast/declaration/type.h"
+#include "spec/ast/expression/expression.h"
+#include "spec/ast/expression/parser_state.h"
+#include "spec/ast/module.h"
+#include "spec/ast/node.h"
+#include "spec/ast/type/unit.h"
+#include "spec/ast/visitor.h"
+
+namespace diffingo {
+namespace generation {
+namespace preprocessing {
+
+using spec::ast::node_ptr;
+
+/// Replaces the parameters of a unit within one of its items by the given
+/// constant expressions.
+class ParameterReplacerVisitor : public spec::ast::Visitor<> {
+ public:
+  ParameterReplacerVisitor();
+  virtual ~ParameterReplacerVisitor();
+
+  bool run(node_ptr<spec::ast::type::unit::item::Item> item,
+           node_ptr<spec::ast::type::unit::Unit> unit,
+           const std::map<std::string,
+                          node_ptr<spec::ast::expression::Expression>>& args);
+
+  using Visitor::visit;
+
+  void visit(node_ptr<spec::ast::type::unit::item::Item> node);
+  void visit(node_ptr<spec::ast::type::unit::item::field::switch_::Case> node);
+  void visit(node_ptr<spec::ast::expression::Expression> node);
+  void visit(node_ptr<spec::ast::expression::ParserState> node);
+
+ private:
+  node_ptr<spec::ast::type::unit::Unit> unit_;
+  const std::map<std::string, node_ptr<spec::ast::expression::Expression>>*
+      args_ = nullptr;
+};
+
+/// Generates a specialized copy of a parameterized unit for each distinct
+/// combination of constant arguments it is embedded with, e.g. a field
+///
+///   message: Message(False, True);
+///
+/// is changed to refer to a new unit Message_False_True without these
+/// parameters. Within the copy, the parameters are replaced by the constants
+/// and conditions of fields as well as switch expressions that became
+/// constant are folded, so that fields that can never be present are removed
+/// and only the matching case of such switches remains. Arguments that
+/// aren't constant remain parameters of the specialized unit.
+class UnitSpecializer : public Pass<> {
+ public:
+  UnitSpecializer();
+  virtual ~UnitSpecializer();
+
+  bool run(node_ptr<spec::ast::Module> node, const Options& options) override;
+
+ private:
+  void specializeFields(node_ptr<spec::ast::type::unit::Unit> unit);
+  node_ptr<spec::ast::declaration::Type> specialize(
+      node_ptr<spec::ast::declaration::Type> decl, const std::string& name,
+      const std::map<std::string, node_ptr<spec::ast::expression::Expression>>&
+          args,
+      const spec::ast::parameter_list& dynamic_params);
+
+  spec::ast::unit_item_list foldItems(const spec::ast::unit_item_list& items);
+  node_ptr<spec::ast::constant::Constant> fold(
+      node_ptr<spec::ast::expression::Expression> expr);
+
+  node_ptr<spec::ast::Module> module_ = nullptr;
+  std::map<spec::ast::type::unit::Unit*,
+           node_ptr<spec::ast::declaration::Type>> decls_;
+  std::map<std::string, node_ptr<spec::ast::declaration::Type>>
+      specializations_;
+  std::list<node_ptr<spec::ast::type::unit::Unit>> pending_;
+
+  ParameterReplacerVisitor param_replacer_;
+  SelfReplacerVisitor self_replacer_;
+};
+
+}  // namespace preprocessing
+}  // namespace generation
+}  // namespace diffingo
+
+#endif  // SRC_GENERATION_PREPROCESSING_UNIT_SPECIALIZER_H_
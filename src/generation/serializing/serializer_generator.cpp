@@ -31,14 +31,20 @@
 #include <kode/function.h>
 #include <kode/membervariable.h>
 #include <pantheios/pantheios.hpp>
+#include <algorithm>
 #include <list>
+#include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "generation/compiler.h"
 #include "spec/ast/attribute.h"
 #include "spec/ast/constant/enum.h"
 #include "spec/ast/expression/constant.h"
+#include "spec/ast/expression/member_attribute.h"
+#include "spec/ast/expression/operator.h"
+#include "spec/ast/expression/transform.h"
 #include "spec/ast/id.h"
 #include "spec/ast/node.h"
 #include "spec/ast/type/atomic_types.h"
@@ -63,20 +69,601 @@ SerializerGenerator::~SerializerGenerator() {}
 
 bool SerializerGenerator::run(node_ptr<ast::type::unit::Unit> node,
                               KODE::Class* serializer_cls,
+                              KODE::Class* builder_cls,
                               const Options& options) {
   cls_ = serializer_cls;
-  root_instr_ = newInstructionLabel("root");
+  builder_ = builder_cls;
   unit_ = node;
   options_ = &options;
+  translator_.set_relative_offsets(options.relative_offsets);
+
+  has_files_ = hasFileFields(unit_->items());
+
+  generateSizeFunction();
+  generateSerializeFunction(Mode::Single);
+  // file segments are positions in the output of a single unit
+  if (!has_files_) generateSerializeFunction(Mode::Batch);
+  if (options.gather_serializing && !has_files_)
+    generateSerializeFunction(Mode::Gather);
+  generateTemplateFunction();
+  patchable_fields_.clear();
+  for (auto item : unit_->items()) collectPatchableFields(item);
+  for (const auto& field : patchable_fields_) generatePatchFunction(field);
+  generateForwardFunction();
+  generateBuilderClass();
+
+  // define macros
+  cls_->addDeclarationMacro("#define POS state->stream_pos()");
+  cls_->addDeclarationMacro("#define BLOCKSTATE state->peek<BlockState>()");
+  cls_->addDeclarationMacro("#define UNIT(type) reinterpret_cast<type*>(unit)");
+  cls_->addDeclarationMacro(
+      "#define UNITPP(type) reinterpret_cast<type**>(&BLOCKSTATE->unit)");
+  cls_->addDeclarationMacro("#define SELF(type) (*UNIT(type))");
+  cls_->addDeclarationMacro(
+      "#define DOLLARP(type) reinterpret_cast<type*>(dollar)");
+  cls_->addDeclarationMacro("#define DOLLAR(type) (*DOLLARP(type))");
+
+  // create serializer constants struct. constants are static constexpr data,
+  // so serializers don't need to initialize them and can share them across
+  // threads.
+  KODE::Class consts("SerializerConstants");
+  consts.addDeclarationMacro("public:");
+  for (auto c : consts_) {
+    consts.addDeclarationMacro(
+        util::fmt("static constexpr const char* %s = %s;", c.first,
+                  translator_.bytesLiteral(c.second)));
+  }
+  cls_->addNestedClass(consts);
+
+  // TODO(ES): create block state entry struct(s)
+  KODE::Class block_state("BlockState");
+  KODE::MemberVariable bs_unit("unit", "char*", false, true);
+  block_state.addMemberVariable(bs_unit);
+  cls_->addNestedClass(block_state);
+
+  // TODO(ES): add a reset function
+
+  return !errors();
+}
+
+void SerializerGenerator::generateSizeFunction() {
+  KODE::Code size_body;
+  code_ = &size_body;
+
+  code_->addLine("size_t size = 0;");
+  for (auto item : unit_->items()) emitItemSize(item);
+  code_->addLine("return size;");
+
+  // sums up the bytes that serialize() writes for the unit, without writing
+  KODE::Function size_func("serializedSize", "size_t",
+                           KODE::Function::Public, true);
+  size_func.addArgument(util::fmt("const %s* unit", translator_.type(unit_)));
+  size_func.setBody(size_body);
+  cls_->addFunction(size_func);
+}
+
+void SerializerGenerator::generateTemplateFunction() {
+  KODE::Code template_body;
+  code_ = &template_body;
+
+  code_->addLine(
+      "if (static_cast<size_t>(out_buf_end - out_buf_start) < tmpl.size())");
+  code_->addLine("  return dr::serializing::SerializeResult::OUT_BUF_FULL;");
+  code_->addLine(
+      "dr::unit::copyMemory(out_buf_start, tmpl.data(), tmpl.size());");
+
+  // fields at fixed offsets can vary between instances of a template. their
+  // offsets are known up to the first field of variable size.
+  KODE::Class fields("TemplateFields");
+  fields.addDeclarationMacro("public:");
+  size_t offset = 0;
+  size_t num_fields = 0;
+  for (auto item : unit_->items()) {
+    if (ast::tryCast<ast::type::unit::item::Property>(item) ||
+        ast::tryCast<ast::type::unit::item::Variable>(item))
+      continue;
+    size_t width;
+    if (!fixedBlockField(item, &width) && !fixedSwitchWidth(item, &width))
+      break;
+
+    auto field = ast::tryCast<ast::type::unit::item::field::Field>(item);
+    bool varies =
+        !ast::tryCast<ast::type::unit::item::field::Constant>(field) &&
+        !ast::tryCast<ast::type::unit::item::field::switch_::Switch>(field) &&
+        !field->anonymous();
+    if (varies && num_fields == 32) {
+      log(pantheios::warning, item,
+          "only the first 32 fields can vary in a wire template");
+    } else if (varies) {
+      auto name = field->id()->name();
+      fields.addDeclarationMacro(util::fmt(
+          "static constexpr uint32_t %s = 1u << %d;", name, num_fields++));
+      code_->addLine(
+          util::fmt("if (tmpl.fields() & TemplateFields::%s)", name));
+      auto member = util::fmt("%s->%s", exprCurrentUnit(),
+                              translator_.unitFieldName(name));
+      if (ast::tryCast<ast::type::Integer>(field->serialized_type())) {
+        code_->addLine(util::fmt(
+            "  dr::serializing::util::storeBits<%d>(out_buf_start + %d, %s);",
+            width, offset, wireBitsExpr(field)));
+      } else {
+        code_->addLine(util::fmt(
+            "  memcpy(out_buf_start + %d, reinterpret_cast<const char*>(&%s), "
+            "%d);",
+            offset, member, width));
+      }
+    }
+    offset += width;
+  }
+  cls_->addNestedClass(fields);
+
+  code_->addLine("*bytes_written = tmpl.size();");
+  code_->addLine("return dr::serializing::SerializeResult::DONE;");
+
+  // instantiates a template recorded with dr::serializing::WireTemplate
+  KODE::Function template_func("serializeTemplate",
+                               "dr::serializing::SerializeResult");
+  template_func.addArgument("char* unit");
+  template_func.addArgument("const dr::serializing::WireTemplate& tmpl");
+  template_func.addArgument("char* out_buf_start");
+  template_func.addArgument("char* out_buf_end");
+  template_func.addArgument("size_t* bytes_written");
+  template_func.setBody(template_body);
+  cls_->addFunction(template_func);
+}
+
+void SerializerGenerator::collectPatchableFields(
+    node_ptr<ast::type::unit::item::Item> item, const std::string& guard) {
+  if (auto sw =
+          ast::tryCast<ast::type::unit::item::field::switch_::Switch>(item)) {
+    size_t index = 0;
+    for (auto c : sw->cases()) {
+      auto case_guard =
+          util::fmt("%s->%s == %d", exprCurrentUnit(),
+                    translator_.unitSwitchCaseName(sw), ++index);
+      if (!guard.empty()) case_guard = guard + " && " + case_guard;
+      for (auto x : c->items()) collectPatchableFields(x, case_guard);
+    }
+    return;
+  }
+  if (!item->attributes()->has("patchable")) return;
+
+  size_t width;
+  auto field = ast::tryCast<ast::type::unit::item::field::Field>(item);
+  if (!field || ast::tryCast<ast::type::unit::item::field::Constant>(field) ||
+      !fixedBlockField(field, &width)) {
+    log(pantheios::error, item, "&patchable requires a fixed-size field");
+    return;
+  }
+  patchable_fields_.push_back(PatchableField{field, width, guard});
+}
+
+void SerializerGenerator::generatePatchFunction(
+    const PatchableField& patchable) {
+  auto field = patchable.field;
+  size_t width = patchable.width;
+
+  // writes a new value into the unit and over the field's bytes in the
+  // message it was parsed from, which can then be forwarded as it is.
+  auto name = field->id()->name();
+  auto member = util::fmt("unit->%s", translator_.unitFieldName(name));
+  auto dest = util::fmt("msg + unit->%s", translator_.unitWireOffsetName(name));
+  KODE::Function patch_func(translator_.patchFunctionName(name),
+                            "dr::serializing::SerializeResult",
+                            KODE::Function::Public, true);
+  patch_func.addArgument("char* msg");
+  patch_func.addArgument(util::fmt("%s* unit", translator_.type(unit_)));
+
+  KODE::Code body;
+  if (!patchable.guard.empty()) {
+    // fields of switch cases that weren't parsed aren't in the message
+    body.addLine(util::fmt("if (!(%s))", patchable.guard));
+    body.addLine("  return dr::serializing::SerializeResult::INVALID_UNIT;");
+  }
+  if (ast::tryCast<ast::type::Integer>(field->serialized_type())) {
+    patch_func.addArgument(
+        util::fmt("%s value", translator_.type(field->type())));
+    body.addLine(util::fmt("%s = value;", member));
+    body.addLine(util::fmt("dr::serializing::util::storeBits<%d>(%s, %s);",
+                           width, dest, wireBitsExpr(field, "value")));
+  } else {
+    // fixed bytes
+    patch_func.addArgument("const char* value");
+    body.addLine(util::fmt("memcpy(&%s, value, %d);", member, width));
+    body.addLine(util::fmt("memcpy(%s, value, %d);", dest, width));
+  }
+  body.addLine("return dr::serializing::SerializeResult::DONE;");
+  patch_func.setBody(body);
+  cls_->addFunction(patch_func);
+}
+
+void SerializerGenerator::generateForwardFunction() {
+  KODE::Code forward_body;
+  code_ = &forward_body;
+
+  code_->addLine(
+      "dr::serializing::MessagePatcher patcher(msg, msg_len, gather);");
+  code_->addLine("dr::serializing::SerializeResult serialize_res;");
+  code_->addLine("char* pos;");
+  code_->newLine();
+
+  // patchable fields are in wire order. fields of switch cases that weren't
+  // parsed have no wire offset and are left out.
+  KODE::Class fields("PatchFields");
+  fields.addDeclarationMacro("public:");
+  size_t num_fields = 0;
+  for (const auto& patchable : patchable_fields_) {
+    if (num_fields == 32) {
+      log(pantheios::warning, patchable.field,
+          "only the first 32 &patchable fields can be rewritten by forward()");
+      continue;
+    }
+    auto field = patchable.field;
+    size_t width = patchable.width;
+    auto name = field->id()->name();
+    fields.addDeclarationMacro(util::fmt(
+        "static constexpr uint32_t %s = 1u << %d;", name, num_fields++));
+
+    if (patchable.guard.empty()) {
+      code_->addLine(util::fmt("if (fields & PatchFields::%s) {", name));
+    } else {
+      code_->addLine(util::fmt("if ((fields & PatchFields::%s) &&", name));
+      code_->addLine(util::fmt("    %s) {", patchable.guard));
+    }
+    code_->indent();
+    code_->addLine(util::fmt("serialize_res = patcher.patch(%s->%s, %d, &pos);",
+                             exprCurrentUnit(),
+                             translator_.unitWireOffsetName(name), width));
+    code_->addLine(
+        "if (serialize_res != dr::serializing::SerializeResult::DONE)");
+    code_->addLine("  return serialize_res;");
+    if (ast::tryCast<ast::type::Integer>(field->serialized_type())) {
+      code_->addLine(
+          util::fmt("dr::serializing::util::storeBits<%d>(pos, %s);", width,
+                    wireBitsExpr(field)));
+    } else {
+      code_->addLine(util::fmt(
+          "memcpy(pos, &%s->%s, %d);", exprCurrentUnit(),
+          translator_.unitFieldName(name), width));
+    }
+    code_->unindent();
+    code_->addLine("}");
+  }
+  cls_->addNestedClass(fields);
+
+  code_->newLine();
+  code_->addLine("return patcher.finish();");
+
+  // forwards a parsed message with some fields rewritten: unchanged ranges
+  // reference the input, rewritten fields the gather list's scratch buffer.
+  KODE::Function forward_func("forward", "dr::serializing::SerializeResult");
+  forward_func.addArgument("char* msg");
+  forward_func.addArgument("size_t msg_len");
+  forward_func.addArgument("char* unit");
+  forward_func.addArgument("uint32_t fields");
+  forward_func.addArgument("dr::serializing::GatherList* gather");
+  forward_func.setBody(forward_body);
+  cls_->addFunction(forward_func);
+}
+
+void SerializerGenerator::generateBuilderClass() {
+  KODE::Class& builder = *builder_;
+  builder_group_.clear();
+  builder_group_width_ = 0;
+  builder_groups_ = 0;
+  builder_derived_.clear();
+  builder_patches_.clear();
+  collectDerivedFields(unit_->items());
+
+  std::vector<size_t> pending;
+  if (!builderItems(unit_->items(), std::vector<std::string>(), &pending)) {
+    // TODO(ES): support lists, embedded units, transforms and conditions
+    builder = KODE::Class(builder.name());
+    return;
+  }
+  closeBuilderGroup(&pending);
+
+  KODE::Code finish_body;
+  code_ = &finish_body;
+  code_->addLine("char* unit = reinterpret_cast<char*>(&unit_);");
+  code_->addLine("char* serialize_src;");
+  code_->addLine("char* dollar;");
+  std::string fills;
+  for (auto g : pending) fills += util::fmt(" || !fill%d()", g);
+  code_->addLine(util::fmt("if (full_%s)", fills));
+  code_->addLine("  return dr::serializing::SerializeResult::OUT_BUF_FULL;");
+  code_->newLine();
+
+  // same updates as serialize(), from the lengths of the written fields
+  for (auto item : unit_->items()) {
+    if (auto f = ast::tryCast<ast::type::unit::item::field::Field>(item)) {
+      updateLengthForField(f);
+    }
+  }
+  for (auto item : unit_->items()) {
+    if (ast::tryCast<ast::type::unit::item::Variable>(item)) processOne(item);
+  }
+  code_->newLine();
+
+  // backpatch the fields reserved by the fill functions
+  for (auto patch : builder_patches_) {
+    auto at = patch.first->id()->name() + "_at_";
+    code_->addLine(util::fmt("if (%s)", at));
+    code_->addLine(
+        util::fmt("  dr::serializing::util::storeBits<%d>(%s, %s);",
+                  patch.second, at, wireBitsExpr(patch.first)));
+  }
+  code_->addLine("*bytes_written = static_cast<size_t>(pos_ - start_);");
+  code_->addLine("return dr::serializing::SerializeResult::DONE;");
+
+  KODE::Function finish_func("finish", "dr::serializing::SerializeResult");
+  finish_func.addArgument("size_t* bytes_written");
+  finish_func.setBody(finish_body);
+  builder.addFunction(finish_func);
+
+  KODE::Function ctor(builder.name());
+  ctor.addArgument("char* out_buf_start");
+  ctor.addArgument("char* out_buf_end");
+  ctor.addInitializer("unit_()");
+  ctor.addInitializer("start_(out_buf_start)");
+  ctor.addInitializer("pos_(out_buf_start)");
+  ctor.addInitializer("end_(out_buf_end)");
+  ctor.addInitializer("step_(0)");
+  ctor.addInitializer("full_(false)");
+  for (auto patch : builder_patches_)
+    ctor.addInitializer(patch.first->id()->name() + "_at_(nullptr)");
+  builder.addFunction(ctor);
+
+  // the unit only holds the scalar values and lengths finish() needs.
+  builder.addMemberVariable(
+      KODE::MemberVariable("unit_", translator_.type(unit_)));
+  builder.addMemberVariable(KODE::MemberVariable("start_", "char*"));
+  builder.addMemberVariable(KODE::MemberVariable("pos_", "char*"));
+  builder.addMemberVariable(KODE::MemberVariable("end_", "char*"));
+  builder.addMemberVariable(KODE::MemberVariable("step_", "size_t"));
+  builder.addMemberVariable(KODE::MemberVariable("full_", "bool"));
+  for (auto patch : builder_patches_) {
+    builder.addMemberVariable(
+        KODE::MemberVariable(patch.first->id()->name() + "_at_", "char*"));
+  }
+}
+
+void SerializerGenerator::collectDerivedFields(
+    const spec::ast::unit_item_list& items) {
+  // fields set from the length of a later field, or by a variable's
+  // &serialize hook, are only known at finish()
+  auto attribute_name = [](node_ptr<ast::expression::Expression> expr) {
+    auto op = ast::tryCast<ast::expression::Operator>(expr);
+    if (!op || (op->kind() != ast::expression::Operator::Kind::Attribute &&
+                op->kind() !=
+                    ast::expression::Operator::Kind::AttributeAssign))
+      return std::string();
+    auto attr = ast::tryCast<ast::expression::MemberAttribute>(
+        *std::next(op->operands().begin()));
+    return attr ? attr->attribute()->name() : std::string();
+  };
+
+  for (auto item : items) {
+    if (auto sw = ast::tryCast<ast::type::unit::item::field::switch_::Switch>(
+            item)) {
+      for (auto c : sw->cases()) {
+        auto case_items = c->items();
+        collectDerivedFields(
+            spec::ast::unit_item_list(case_items.begin(), case_items.end()));
+      }
+    } else if (ast::tryCast<ast::type::unit::item::Variable>(item)) {
+      if (!item->attributes()->has("serialize")) continue;
+      auto hook = item->attributes()->lookup("serialize")->value();
+      for (auto node : hook->children(true)) {
+        auto expr = ast::tryCast<ast::expression::Operator>(node);
+        if (expr &&
+            expr->kind() == ast::expression::Operator::Kind::AttributeAssign)
+          builder_derived_.insert(attribute_name(expr));
+      }
+    }
+    if (item->attributes()->has("length")) {
+      auto name = attribute_name(item->attributes()->lookup("length")->value());
+      if (!name.empty()) builder_derived_.insert(name);
+    }
+  }
+}
+
+bool SerializerGenerator::builderItems(
+    const spec::ast::unit_item_list& items,
+    const std::vector<std::string>& case_assigns,
+    std::vector<size_t>* pending) {
+  for (auto item : items) {
+    auto name = item->id()->name();
+    auto member = translator_.unitFieldName(name);
+    bool derived = builder_derived_.count(name) > 0;
+
+    if (ast::tryCast<ast::type::unit::item::Property>(item)) continue;
+    if (ast::tryCast<ast::type::unit::item::Variable>(item)) {
+      if (derived || !item->application_accessible()) continue;
+      KODE::Function setter(name, builder_->name() + "&");
+      setter.addArgument(
+          util::fmt("%s value", translator_.type(item->type())));
+      KODE::Code body;
+      body.addLine(util::fmt("unit_.%s = value;", member));
+      body.addLine("return *this;");
+      setter.setBody(body);
+      builder_->addFunction(setter);
+      continue;
+    }
+
+    if (auto sw = ast::tryCast<ast::type::unit::item::field::switch_::Switch>(
+            item)) {
+      if (sw->condition()) return false;
+      closeBuilderGroup(pending);
+      size_t index = 0;
+      for (auto c : sw->cases()) {
+        auto assigns = case_assigns;
+        assigns.push_back(util::fmt("unit_.%s = %d;",
+                                    translator_.unitSwitchCaseName(sw),
+                                    ++index));
+        std::vector<size_t> case_pending = *pending;
+        auto case_items = c->items();
+        if (!builderItems(spec::ast::unit_item_list(case_items.begin(),
+                                                    case_items.end()),
+                          assigns, &case_pending))
+          return false;
+        closeBuilderGroup(&case_pending);
+        // fields after the last setter of a case would never be written
+        for (auto g : case_pending) {
+          if (std::find(pending->begin(), pending->end(), g) == pending->end())
+            return false;
+        }
+      }
+      continue;
+    }
+
+    auto field = ast::tryCast<ast::type::unit::item::field::Field>(item);
+    if (!field || field->condition() ||
+        field->attributes()->has("transform") ||
+        field->attributes()->has("file"))
+      return false;
+    auto type = field->serialized_type();
+    size_t width;
+    bool fixed = fixedBlockField(field, &width);
+
+    if (auto c = ast::tryCast<ast::type::unit::item::field::Constant>(field)) {
+      std::string bytes;
+      if (!serializedConstant(c, &bytes)) return false;
+      builder_group_.addLine(
+          util::fmt("memcpy(pos_, %s::SerializerConstants::%s, %d);",
+                    cls_->name(), addConstant(bytes), bytes.size()));
+      builder_group_.addLine(util::fmt("pos_ += %d;", bytes.size()));
+      builder_group_width_ += bytes.size();
+      continue;
+    }
+    if (derived) {
+      // reserved here, written at finish()
+      if (!fixed || !ast::tryCast<ast::type::Integer>(type)) return false;
+      builder_group_.addLine(util::fmt("%s_at_ = pos_;", name));
+      builder_group_.addLine(util::fmt("pos_ += %d;", width));
+      builder_group_width_ += width;
+      builder_patches_.push_back(std::make_pair(field, width));
+      continue;
+    }
+    if (!field->application_accessible()) {
+      // e.g. reserved bytes, which the application can't set
+      if (!fixed && !(ast::tryCast<ast::type::Bytes>(type) &&
+                      translator_.fixedBytesLength(field, &width)))
+        return false;
+      builder_group_.addLine(util::fmt("memset(pos_, 0, %d);", width));
+      builder_group_.addLine(util::fmt("pos_ += %d;", width));
+      builder_group_width_ += width;
+      continue;
+    }
+    if (!ast::tryCast<ast::type::unit::item::field::AtomicType>(field))
+      return false;
+
+    KODE::Function setter(name, builder_->name() + "&");
+    KODE::Code body;
+    closeBuilderGroup(pending);
+    std::string check = "full_";
+    for (auto g : *pending) check += util::fmt(" || !fill%d()", g);
+    pending->clear();
+
+    if (fixed && ast::tryCast<ast::type::Integer>(type)) {
+      setter.addArgument(
+          util::fmt("%s value", translator_.type(field->type())));
+      body.addLine(util::fmt("if (%s || end_ - pos_ < %d) {", check, width));
+      body.addLine("  full_ = true;");
+      body.addLine("  return *this;");
+      body.addLine("}");
+      body.addLine(util::fmt("unit_.%s = value;", member));
+      body.addLine(util::fmt("dr::serializing::util::storeBits<%d>(pos_, %s);",
+                             width, wireBitsExpr(field, "value")));
+      body.addLine(util::fmt("pos_ += %d;", width));
+    } else if (fixed) {
+      setter.addArgument("const char* value");
+      body.addLine(util::fmt("if (%s || end_ - pos_ < %d) {", check, width));
+      body.addLine("  full_ = true;");
+      body.addLine("  return *this;");
+      body.addLine("}");
+      body.addLine(util::fmt("memcpy(pos_, value, %d);", width));
+      body.addLine(util::fmt("pos_ += %d;", width));
+    } else if (type == field->type() &&
+               (ast::tryCast<ast::type::Bytes>(type) ||
+                ast::tryCast<ast::type::String>(type))) {
+      // appends, so values of unknown length can be streamed in chunks
+      setter.addArgument("const char* data");
+      setter.addArgument("size_t len");
+      body.addLine(util::fmt(
+          "if (%s || static_cast<size_t>(end_ - pos_) < len) {", check));
+      body.addLine("  full_ = true;");
+      body.addLine("  return *this;");
+      body.addLine("}");
+      body.addLine("dr::unit::copyMemory(pos_, data, len);");
+      body.addLine("pos_ += len;");
+      body.addLine(util::fmt("reinterpret_cast<%s*>(&unit_.%s)->len_ += len;",
+                             translator_.type(type), member));
+    } else {
+      return false;
+    }
+    for (auto assign : case_assigns) body.addLine(assign);
+    body.addLine("return *this;");
+    setter.setBody(body);
+    builder_->addFunction(setter);
+  }
+  return true;
+}
+
+void SerializerGenerator::closeBuilderGroup(std::vector<size_t>* pending) {
+  if (builder_group_width_ == 0) return;
+
+  size_t group = ++builder_groups_;
+  KODE::Code body;
+  body.addLine(util::fmt("if (step_ >= %d) return true;", group));
+  body.addLine(util::fmt("if (end_ - pos_ < %d) return false;",
+                         builder_group_width_));
+  body.addBlock(builder_group_);
+  body.addLine(util::fmt("step_ = %d;", group));
+  body.addLine("return true;");
+
+  KODE::Function fill_func(util::fmt("fill%d", group), "bool",
+                           KODE::Function::Private);
+  fill_func.setBody(body);
+  builder_->addFunction(fill_func);
+
+  pending->push_back(group);
+  builder_group_.clear();
+  builder_group_width_ = 0;
+}
+
+bool SerializerGenerator::hasFileFields(
+    const spec::ast::unit_item_list& items) {
+  for (auto item : items) {
+    if (item->attributes()->has("file")) return true;
+    if (auto sw = ast::tryCast<ast::type::unit::item::field::switch_::Switch>(
+            item)) {
+      for (auto c : sw->cases()) {
+        auto case_items = c->items();
+        if (hasFileFields(spec::ast::unit_item_list(case_items.begin(),
+                                                    case_items.end())))
+          return true;
+      }
+    }
+  }
+  return false;
+}
+
+void SerializerGenerator::generateSerializeFunction(Mode mode) {
+  gather_ = mode == Mode::Gather;
+  batch_ = mode == Mode::Batch;
+  // the gather list's scratch buffer only holds small fields, so only the
+  // flat serializers check the size of each unit up front.
+  presized_ = !gather_;
+  root_instr_ = newInstructionLabel("root");
+  temp_vars_.clear();
 
   // -- create code blocks that will be filled during visiting unit elements --
-  KODE::Code init_consts_body;
-  init_consts_code_ = &init_consts_body;
   KODE::Code serialize_body_inner;
   code_ = &serialize_body_inner;
 
   // process length field updates
-  for (auto item : node->items()) {
+  for (auto item : unit_->items()) {
     if (auto f = ast::tryCast<ast::type::unit::item::field::Field>(item)) {
       updateLengthForField(f);
     }
@@ -84,20 +671,48 @@ bool SerializerGenerator::run(node_ptr<ast::type::unit::Unit> node,
   code_->newLine();
 
   // execute variables first
-  for (auto item : node->items()) {
+  for (auto item : unit_->items()) {
     if (ast::tryCast<ast::type::unit::item::Variable>(item)) {
       serialize(item);
     }
   }
   code_->newLine();
 
-  // serialize sequence of items and fill body of serialize method
-  for (auto item : node->items()) {
-    if (!ast::tryCast<ast::type::unit::item::Property>(item) &&
-        !ast::tryCast<ast::type::unit::item::Variable>(item)) {
-      serialize(item);
+  for (auto item : unit_->items()) emitCaseSelection(item);
+
+  if (presized_) {
+    // single bounds check for all fields, after the length updates. batches
+    // stop before the first unit that doesn't fit.
+    auto instr_label = newInstructionLabel(
+        util::fmt("check_size_%s", unit_->id()->name()));
+    emitInitInstruction(instr_label);
+    code_->addLine("if (static_cast<size_t>(out_buf_end - *POS) <");
+    code_->addLine(
+        util::fmt("    serializedSize(%s))", exprCurrentUnit()));
+    code_->addLine(batch_
+                       ? "  break;"
+                       : "  return dr::serializing::SerializeResult::"
+                         "OUT_BUF_FULL;");
+    code_->newLine();
+  }
+
+  // serialize sequence of items and fill body of serialize method. runs of
+  // fixed-size fields are serialized as one block.
+  FixedBlock block;
+  for (auto item : unit_->items()) {
+    if (ast::tryCast<ast::type::unit::item::Property>(item) ||
+        ast::tryCast<ast::type::unit::item::Variable>(item))
+      continue;
+    size_t width;
+    if (fixedBlockField(item, &width)) {
+      block.push_back(std::make_pair(
+          ast::checkedCast<ast::type::unit::item::field::Field>(item), width));
+      continue;
     }
+    flushFixedBlock(&block);
+    serialize(item);
   }
+  flushFixedBlock(&block);
 
   // -- add code to serializer class --
 
@@ -105,6 +720,12 @@ bool SerializerGenerator::run(node_ptr<ast::type::unit::Unit> node,
   code_ = &serialize_body;
 
   // add temp var declarations
+  if (gather_) {
+    // small fields are serialized into the gather list's scratch buffer
+    code_->addLine("char* out_buf_start = gather->scratchStart();");
+    code_->addLine("char* out_buf_end = gather->scratchEnd();");
+  }
+  if (batch_) code_->addLine("char* unit;");
   code_->addLine("char* serialize_src;");
   code_->addLine("dr::serializing::SerializeResult serialize_res;");
   code_->addLine("char* dollar;");
@@ -113,73 +734,84 @@ bool SerializerGenerator::run(node_ptr<ast::type::unit::Unit> node,
   }
   code_->newLine();
 
-  // root instruction
-  code_->addLine(root_instr_ + ":");
-  code_->addLine("if (state->instruction()) {");
-  code_->addLine("  unit = BLOCKSTATE->unit;");
-  code_->addLine("  goto *state->instruction();");
-  code_->addLine("}");
-  code_->newLine();
+  if (!batch_) {
+    // root instruction
+    code_->addLine(root_instr_ + ":");
+    code_->addLine("if (state->instruction()) {");
+    code_->addLine("  unit = BLOCKSTATE->unit;");
+    code_->addLine("  goto *state->instruction();");
+    code_->addLine("}");
+    code_->newLine();
+  }
 
   // push new block state, init unit pointer within state
   emitPushBlockState();
-  code_->addLine("BLOCKSTATE->unit = unit;");
+  if (!batch_) code_->addLine("BLOCKSTATE->unit = unit;");
 
   // init stream position
   code_->addLine("*POS = out_buf_start;");
+  if (gather_) code_->addLine("gather->clear();");
+  if (has_files_) code_->addLine("files->clear();");
   code_->newLine();
 
-  code_->addBlock(serialize_body_inner);
-
-  // update bytes_read and return
-  code_->addLine("*bytes_written = *POS - out_buf_start;");
-  code_->addLine("return dr::serializing::SerializeResult::DONE;");
-
-  // define macros
-  cls_->addDeclarationMacro("#define POS state->stream_pos()");
-  cls_->addDeclarationMacro("#define BLOCKSTATE state->peek<BlockState>()");
-  cls_->addDeclarationMacro("#define UNIT(type) reinterpret_cast<type*>(unit)");
-  cls_->addDeclarationMacro(
-      "#define UNITPP(type) reinterpret_cast<type**>(&BLOCKSTATE->unit)");
-  cls_->addDeclarationMacro("#define SELF(type) (*UNIT(type))");
-  cls_->addDeclarationMacro(
-      "#define DOLLARP(type) reinterpret_cast<type*>(dollar)");
-  cls_->addDeclarationMacro("#define DOLLAR(type) (*DOLLARP(type))");
-
-  // create serializer constants struct
-  KODE::Class consts("SerializerConstants");
-  for (auto m : consts_) {
-    consts.addMemberVariable(m);
+  if (batch_) {
+    // serialize units back to back, sharing the setup above
+    code_->addLine("size_t index = 0;");
+    code_->addLine("for (; index < num_units; ++index) {");
+    code_->indent();
+    code_->addLine("unit = units[index];");
+    code_->addLine("BLOCKSTATE->unit = unit;");
+    code_->addBlock(serialize_body_inner);
+    code_->unindent();
+    code_->addLine("}");
+    code_->newLine();
+  } else {
+    code_->addBlock(serialize_body_inner);
   }
-  cls_->addNestedClass(consts);
-  KODE::MemberVariable consts_var("consts_", "SerializerConstants", false,
-                                  true);
-  cls_->addMemberVariable(consts_var);
-  KODE::Function init_consts("initSerializerConstants", "void",
-                             KODE::Function::Private, false);
-  init_consts.setBody(init_consts_body);
-  cls_->addFunction(init_consts);
 
-  // TODO(ES): create block state entry struct(s)
-  KODE::Class block_state("BlockState");
-  KODE::MemberVariable bs_unit("unit", "char*", false, true);
-  block_state.addMemberVariable(bs_unit);
-  cls_->addNestedClass(block_state);
+  if (gather_) {
+    // close the gather list with the remaining scratch bytes and return
+    code_->addLine("if (!gather->finish(*POS))");
+    code_->addLine("  return dr::serializing::SerializeResult::OUT_BUF_FULL;");
+  } else {
+    // update bytes_read and return
+    code_->addLine("*bytes_written = *POS - out_buf_start;");
+  }
+  if (batch_) {
+    code_->addLine("*units_written = index;");
+    code_->addLine("if (index < num_units)");
+    code_->addLine("  return dr::serializing::SerializeResult::OUT_BUF_FULL;");
+  }
+  code_->addLine("return dr::serializing::SerializeResult::DONE;");
 
   // generate and add serialize function
-  KODE::Function serialize_func("serialize",
-                                "dr::serializing::SerializeResult");
-  serialize_func.addArgument("char* unit");
-  serialize_func.addArgument("char* out_buf_start");
-  serialize_func.addArgument("char* out_buf_end");
+  const char* name = "serialize";
+  if (gather_) name = "serializeGather";
+  if (batch_) name = "serializeBatch";
+  KODE::Function serialize_func(name, "dr::serializing::SerializeResult");
+  if (batch_) {
+    serialize_func.addArgument("char** units");
+    serialize_func.addArgument("size_t num_units");
+  } else {
+    serialize_func.addArgument("char* unit");
+  }
+  if (gather_) {
+    serialize_func.addArgument("dr::serializing::GatherList* gather");
+  } else {
+    serialize_func.addArgument("char* out_buf_start");
+    serialize_func.addArgument("char* out_buf_end");
+  }
   serialize_func.addArgument("dr::parsing::ParserState* state");
-  serialize_func.addArgument("size_t* bytes_written");
+  if (!gather_) serialize_func.addArgument("size_t* bytes_written");
+  if (batch_) serialize_func.addArgument("size_t* units_written");
+  if (has_files_)
+    serialize_func.addArgument("dr::serializing::FileSegments* files");
   serialize_func.setBody(serialize_body);
   cls_->addFunction(serialize_func);
 
-  // TODO(ES): add a reset function
-
-  return !errors();
+  gather_ = false;
+  batch_ = false;
+  presized_ = false;
 }
 
 void SerializerGenerator::visit(
@@ -203,8 +835,6 @@ void SerializerGenerator::visit(
                                translator_.type(node->serialized_type()),
                                exprCurrentUnit(),
                                translator_.unitFieldName(node->id()->name())));
-    } else if (node->attributes()->has("transform")) {
-      // TODO(ES): support custom transforms
     } else {
       log(pantheios::error, node,
           "unknown case for serialized type != internal type");
@@ -232,10 +862,19 @@ void SerializerGenerator::visit(
 
 void SerializerGenerator::visit(
     node_ptr<ast::type::unit::item::field::Constant> node) {
-  // TODO(ES)
-  // statically convert constant to byte array in serialized format
-  // add constant field to unit's "SerializerConstants" struct
-  // copy to output
+  std::string bytes;
+  if (!serializedConstant(node, &bytes)) {
+    log(pantheios::error, node, "constant has no static serialized form");
+    return;
+  }
+
+  // add constant field to unit's "SerializerConstants" struct, then copy to
+  // output
+  code_->addLine(util::fmt(
+      "serialize_res = dr::serializing::util::copyConstant%s("
+      "SerializerConstants::%s, POS, out_buf_end);",
+      templateArgs(util::fmt("%d", bytes.size())), addConstant(bytes)));
+  emitCheckSerializeResult();
 }
 
 void SerializerGenerator::visit(
@@ -268,28 +907,25 @@ void SerializerGenerator::visit(
 
 void SerializerGenerator::visit(
     node_ptr<spec::ast::type::unit::item::field::switch_::Switch> node) {
-  // TODO(ES): support switch as union struct
-  if (node->expression()) {
-    code_->addLine(
-        util::fmt("switch (%s){", translator_.expression(node->expression())));
-    for (auto c : node->cases()) {
-      for (auto e : c->expressions()) {
-        code_->addLine(util::fmt("case %s:", translator_.expression(e)));
-      }
-      if (c->_default()) {
-        code_->addLine("default:");
-      }
-      code_->indent();
-      for (auto x : c->items()) {
-        serialize(x);
-      }
-      code_->addLine("break;");
-      code_->unindent();
+  // dispatch on the case index, set from the switch expression (or checked)
+  // by emitCaseSelection() before any field is written.
+  code_->addLine(util::fmt("switch (%s->%s) {", exprCurrentUnit(),
+                           translator_.unitSwitchCaseName(node)));
+  size_t index = 0;
+  for (auto c : node->cases()) {
+    code_->addLine(util::fmt("case %d:", ++index));
+    code_->indent();
+    for (auto x : c->items()) {
+      serialize(x);
     }
-    code_->addLine("}");
-  } else {
-    // TODO(ES): support look-ahead switch
+    code_->addLine("break;");
+    code_->unindent();
   }
+  code_->addLine("default:");
+  code_->indent();
+  emitInvalidUnit();
+  code_->unindent();
+  code_->addLine("}");
 }
 
 void SerializerGenerator::visit(
@@ -317,18 +953,38 @@ void SerializerGenerator::visit(node_ptr<spec::ast::type::Bytes> node) {
   // TODO(ES): support incremental copy of byte fields
   // only if "chunked" attr is given?
 
-  if (!use_input_pointer_) {
+  auto item = current<ast::type::unit::item::Item>();
+  if (item->attributes()->has("file")) {
+    // received values are copied. file ranges are sent at this position of
+    // the output, see FileSender. their segments aren't part of the up-front
+    // size check.
+    code_->addLine("if ((*((dr::unit::file_range*) serialize_src)).fd_ < 0) {");
+    code_->indent();
+    emitCopyBytes("dr::unit::file_range", "data_");
+    emitCheckSerializeResult();
+    code_->unindent();
     code_->addLine(
-        "serialize_res = dr::serializing::util::copyBytes("
-        "(*((dr::unit::var_bytes*) serialize_src)).data_, "
-        "(*((dr::unit::var_bytes*) serialize_src)).len_, "
-        "POS, out_buf_end);");
+        "} else if (!files->add(static_cast<size_t>(*POS - out_buf_start),");
+    code_->addLine("                       "
+                   "*((dr::unit::file_range*) serialize_src))) {");
+    code_->addLine("  return dr::serializing::SerializeResult::OUT_BUF_FULL;");
+    code_->addLine("}");
+    return;
+  }
+
+  size_t fixed_length;
+  if (!use_input_pointer_ &&
+      translator_.fixedBytesLength(item, &fixed_length)) {
+    code_->addLine(util::fmt(
+        "serialize_res = dr::serializing::util::copyFixedBytes%s("
+        "serialize_src, POS, out_buf_end);",
+        templateArgs(util::fmt("%d", fixed_length))));
+  } else if (!use_input_pointer_) {
+    // var_bytes, or rel_bytes in relative offsets mode
+    emitCopyBytes(translator_.type(node), "data_");
   } else {
-    code_->addLine(
-        "serialize_res = dr::serializing::util::copyBytes("
-        "(*((dr::unit::var_stream_range*) serialize_src)).start_, "
-        "(*((dr::unit::var_stream_range*) serialize_src)).len_, "
-        "POS, out_buf_end);");
+    // in gather mode, references the original input range
+    emitCopyBytes("dr::unit::var_stream_range", "start_");
     // TODO(ES): decrement reference counting of original input buffer
   }
   emitCheckSerializeResult();
@@ -351,9 +1007,10 @@ void SerializerGenerator::visit(node_ptr<spec::ast::type::Enum> node) {
 void SerializerGenerator::visit(node_ptr<spec::ast::type::Integer> node) {
   auto byteorder = byteOrderLabel(node);
   code_->addLine(util::fmt(
-      "serialize_res = dr::serializing::util::serializeInt%d_%s_%s("
+      "serialize_res = dr::serializing::util::serializeInt%d_%s_%s%s("
       "serialize_src, POS, out_buf_end);",
-      node->width(), node->_signed() ? "signed" : "unsigned", byteorder));
+      node->width(), node->_signed() ? "signed" : "unsigned", byteorder,
+      templateArgs()));
   emitCheckSerializeResult();
 }
 
@@ -379,11 +1036,7 @@ void SerializerGenerator::visit(node_ptr<spec::ast::type::String> node) {
 
   // TODO(ES): assuming ascii here, what about other encodings?
 
-  code_->addLine(
-      "serialize_res = dr::serializing::util::copyBytes("
-      "(*((dr::unit::var_string*) serialize_src)).data_, "
-      "(*((dr::unit::var_string*) serialize_src)).len_, "
-      "POS, out_buf_end);");
+  emitCopyBytes(translator_.type(node), "data_");
   emitCheckSerializeResult();
 
   // TODO(ES): support "chunked" string fields?
@@ -438,7 +1091,14 @@ void SerializerGenerator::serialize(
   code_ = &instr;
 
   emitInitInstruction(instr_label);
-  processOne(item);
+  emitWireOffset(item, 0);
+  if (ast::tryCast<ast::type::unit::item::field::Field>(item) &&
+      item->attributes()->has("transform")) {
+    // transforms encode directly from the field into the output buffer.
+    emitTransformEncode(item);
+  } else {
+    processOne(item);
+  }
 
   item_ = item_tmp;
   code_ = code_tmp;
@@ -466,32 +1126,378 @@ void SerializerGenerator::updateLengthForField(
               util::fmt("serialize_src = reinterpret_cast<char*>(&%s->%s);",
                         exprCurrentUnit(),
                         translator_.unitFieldName(field->id()->name())));
-          code_->addLine(
-              util::fmt("%s = (*((dr::unit::var_bytes*) serialize_src)).len_;",
-                        length_str));
+          code_->addLine(util::fmt(
+              "%s = (*((%s*) serialize_src)).len_;", length_str,
+              translator_.type(field->serialized_type())));
         }
       }
     }
   }
 }
 
+void SerializerGenerator::emitItemSize(
+    node_ptr<ast::type::unit::item::Item> item) {
+  auto field = ast::tryCast<ast::type::unit::item::field::Field>(item);
+  if (!field) return;
+
+  auto member = util::fmt("unit->%s",
+                          translator_.unitFieldName(field->id()->name()));
+
+  if (auto sw = ast::tryCast<ast::type::unit::item::field::switch_::Switch>(
+          field)) {
+    code_->addLine(
+        util::fmt("switch (unit->%s) {", translator_.unitSwitchCaseName(sw)));
+    size_t index = 0;
+    for (auto c : sw->cases()) {
+      code_->addLine(util::fmt("case %d:", ++index));
+      code_->indent();
+      for (auto x : c->items()) emitItemSize(x);
+      code_->addLine("break;");
+      code_->unindent();
+    }
+    // without a valid case, the unit doesn't fit into any buffer
+    code_->addLine("default:");
+    code_->addLine("  return SIZE_MAX;");
+    code_->addLine("}");
+  } else if (auto c =
+                 ast::tryCast<ast::type::unit::item::field::Constant>(field)) {
+    std::string bytes;
+    if (serializedConstant(c, &bytes))
+      code_->addLine(util::fmt("size += %d;", bytes.size()));
+  } else if (field->attributes()->has("transform")) {
+    auto attr = field->attributes()->lookup("transform");
+    if (auto transform =
+            ast::tryCast<ast::expression::Transform>(attr->value())) {
+      code_->addLine(util::fmt(
+          "size += %s::encodedLength(reinterpret_cast<const char*>(&%s));",
+          translator_.transformName(transform->transform()->id()->name()),
+          member));
+    }
+  } else if (field->attributes()->has("file")) {
+    // file ranges are sent from the file, only received values are written
+    code_->addLine(util::fmt("if (%s.fd_ < 0) size += %s.len_;", member,
+                             member));
+  } else if (ast::tryCast<ast::type::unit::item::field::AtomicType>(field)) {
+    auto type = field->serialized_type();
+    size_t fixed_length;
+    bool input_pointer =
+        !field->application_accessible() && options_->input_pointers;
+    if (auto int_type = ast::tryCast<ast::type::Integer>(type)) {
+      code_->addLine(util::fmt("size += %d;", int_type->width() / 8));
+    } else if (ast::tryCast<ast::type::Bytes>(type) && !input_pointer &&
+               translator_.fixedBytesLength(field, &fixed_length)) {
+      code_->addLine(util::fmt("size += %d;", fixed_length));
+    } else if (ast::tryCast<ast::type::Bytes>(type) ||
+               ast::tryCast<ast::type::String>(type)) {
+      code_->addLine(util::fmt("size += %s.len_;", member));
+    }
+    // TODO(ES): other types, once they are serialized
+  }
+  // TODO(ES): embedded units, lists, vectors and ctors, once they are
+  // serialized
+}
+
+void SerializerGenerator::emitCaseSelection(
+    node_ptr<ast::type::unit::item::Item> item) {
+  auto sw = ast::tryCast<ast::type::unit::item::field::switch_::Switch>(item);
+  if (!sw) return;
+
+  auto index_member = util::fmt("%s->%s", exprCurrentUnit(),
+                                translator_.unitSwitchCaseName(sw));
+  code_->addLine(util::fmt("switch (%s) {",
+                           sw->expression()
+                               ? translator_.expression(sw->expression())
+                               : index_member));
+  size_t index = 0;
+  bool has_default = false;
+  for (auto c : sw->cases()) {
+    ++index;
+    if (sw->expression()) {
+      for (auto e : c->expressions()) {
+        code_->addLine(util::fmt("case %s:", translator_.expression(e)));
+      }
+      if (c->_default()) {
+        code_->addLine("default:");
+        has_default = true;
+      }
+      code_->indent();
+      code_->addLine(util::fmt("%s = %d;", index_member, index));
+    } else {
+      code_->addLine(util::fmt("case %d:", index));
+      code_->indent();
+    }
+    for (auto x : c->items()) emitCaseSelection(x);
+    code_->addLine("break;");
+    code_->unindent();
+  }
+  if (!has_default) {
+    code_->addLine("default:");
+    code_->indent();
+    emitInvalidUnit();
+    code_->unindent();
+  }
+  code_->addLine("}");
+}
+
+void SerializerGenerator::emitInvalidUnit() {
+  if (batch_) {
+    // report the units before the invalid one as written
+    code_->addLine("*bytes_written = *POS - out_buf_start;");
+    code_->addLine("*units_written = index;");
+  }
+  code_->addLine("return dr::serializing::SerializeResult::INVALID_UNIT;");
+}
+
+bool SerializerGenerator::fixedBlockField(
+    node_ptr<ast::type::unit::item::Item> item, size_t* width) {
+  auto field = ast::tryCast<ast::type::unit::item::field::Field>(item);
+  if (!field || field->condition() || field->attributes()->has("transform") ||
+      field->attributes()->has("file"))
+    return false;
+
+  if (auto c = ast::tryCast<ast::type::unit::item::field::Constant>(field)) {
+    std::string bytes;
+    if (!serializedConstant(c, &bytes)) return false;
+    *width = bytes.size();
+    return true;
+  }
+  if (!ast::tryCast<ast::type::unit::item::field::AtomicType>(field))
+    return false;
+
+  auto type = field->serialized_type();
+  if (auto int_type = ast::tryCast<ast::type::Integer>(type)) {
+    if (type != field->type() && !field->attributes()->has("transform_to"))
+      return false;
+    *width = static_cast<size_t>(int_type->width()) / 8;
+    return true;
+  }
+  bool input_pointer =
+      !field->application_accessible() && options_->input_pointers;
+  return type == field->type() && ast::tryCast<ast::type::Bytes>(type) &&
+         !input_pointer && translator_.fixedBytesLength(field, width);
+}
+
+bool SerializerGenerator::fixedSwitchWidth(
+    node_ptr<ast::type::unit::item::Item> item, size_t* width) {
+  auto sw = ast::tryCast<ast::type::unit::item::field::switch_::Switch>(item);
+  if (!sw || sw->condition() || sw->cases().empty()) return false;
+
+  // all cases need to consist of fixed-size fields of the same total size
+  bool first = true;
+  for (auto c : sw->cases()) {
+    size_t case_width = 0;
+    for (auto x : c->items()) {
+      size_t w;
+      if (!fixedBlockField(x, &w)) return false;
+      case_width += w;
+    }
+    if (!first && case_width != *width) return false;
+    *width = case_width;
+    first = false;
+  }
+  return true;
+}
+
+void SerializerGenerator::flushFixedBlock(FixedBlock* block) {
+  if (block->size() == 1) serialize(block->front().first);
+  if (block->size() > 1) emitFixedBlock(*block);
+  block->clear();
+}
+
+void SerializerGenerator::emitFixedBlock(const FixedBlock& block) {
+  std::string instr_label = newInstructionLabel(util::fmt(
+      "serialize_%s_%s_to_%s", unit_->id()->name(),
+      block.front().first->id()->name(), block.back().first->id()->name()));
+
+  KODE::Code instr;
+  auto code_tmp = code_;
+  code_ = &instr;
+  emitInitInstruction(instr_label);
+
+  size_t size = 0;
+  for (auto f : block) size += f.second;
+  // constant bytes are folded into the words' initial values
+  std::vector<uint64_t> words((size + 7) / 8, 0);
+  std::list<std::string> lines;
+  auto add_bits = [&](const std::string& bits, size_t offset, size_t width) {
+    size_t word = offset / 8;
+    size_t shift = 8 * (offset % 8);
+    lines.push_back(util::fmt("bits = %s;", bits));
+    if (shift == 0)
+      lines.push_back(util::fmt("words[%d] |= bits;", word));
+    else
+      lines.push_back(util::fmt("words[%d] |= bits << %d;", word, shift));
+    // spills into the next word
+    if (offset % 8 + width > 8)
+      lines.push_back(
+          util::fmt("words[%d] |= bits >> %d;", word + 1, 64 - shift));
+  };
+
+  size_t offset = 0;
+  for (auto f : block) {
+    auto field = f.first;
+    emitWireOffset(field, offset);
+    auto member = util::fmt("%s->%s", exprCurrentUnit(),
+                            translator_.unitFieldName(field->id()->name()));
+    auto type = field->serialized_type();
+    if (auto c = ast::tryCast<ast::type::unit::item::field::Constant>(field)) {
+      std::string bytes;
+      serializedConstant(c, &bytes);
+      for (size_t i = 0; i < bytes.size(); ++i) {
+        words[(offset + i) / 8] |=
+            static_cast<uint64_t>(static_cast<unsigned char>(bytes[i]))
+            << (8 * ((offset + i) % 8));
+      }
+    } else if (ast::tryCast<ast::type::Integer>(type)) {
+      add_bits(wireBitsExpr(field), offset, f.second);
+    } else {
+      // fixed bytes, in chunks of up to one word
+      for (size_t chunk = 0; chunk < f.second; chunk += 8) {
+        size_t len = std::min<size_t>(8, f.second - chunk);
+        add_bits(util::fmt("dr::serializing::util::bytesBits<%d>("
+                           "reinterpret_cast<const char*>(&%s) + %d)",
+                           len, member, chunk),
+                 offset + chunk, len);
+      }
+    }
+    offset += f.second;
+  }
+
+  std::string init;
+  for (auto w : words) {
+    if (!init.empty()) init += ", ";
+    init += util::fmt("0x%xULL", w);
+  }
+
+  code_->addLine("{");
+  code_->indent();
+  code_->addLine(util::fmt("uint64_t words[%d] = {%s};", words.size(), init));
+  if (!lines.empty()) code_->addLine("uint64_t bits;");
+  for (auto line : lines) code_->addLine(line);
+  code_->addLine(util::fmt(
+      "serialize_res = dr::serializing::util::copyConstant%s("
+      "reinterpret_cast<const char*>(words), POS, out_buf_end);",
+      templateArgs(util::fmt("%d", size))));
+  code_->unindent();
+  code_->addLine("}");
+  emitCheckSerializeResult();
+
+  code_ = code_tmp;
+  instr.newLine();
+  code_->addBlock(instr);
+}
+
+std::string SerializerGenerator::wireBitsExpr(
+    node_ptr<ast::type::unit::item::field::Field> field, std::string value) {
+  auto type = field->serialized_type();
+  auto int_type = ast::checkedCast<ast::type::Integer>(type);
+  auto int_name = util::fmt("%sint%d_t", int_type->_signed() ? "" : "u",
+                            int_type->width());
+  if (value.empty()) {
+    value = util::fmt("%s->%s", exprCurrentUnit(),
+                      translator_.unitFieldName(field->id()->name()));
+  }
+  // transform_to fields are cast to their serialized type
+  if (type != field->type()) value = util::fmt("(%s) %s", int_name, value);
+  return util::fmt("dr::serializing::util::wireBits<%s, %s>(%s)", int_name,
+                   byteOrderLabel(int_type, field) == "big" ? "true" : "false",
+                   value);
+}
+
+bool SerializerGenerator::serializedConstant(
+    node_ptr<ast::type::unit::item::field::Constant> node, std::string* bytes) {
+  // statically convert constant to byte array in serialized format
+  bool big_endian = true;
+  if (auto int_type = translator_.constantIntegerType(node->constant()))
+    big_endian = byteOrderLabel(int_type, node) == "big";
+  return translator_.serializedConstant(node->constant(), big_endian, bytes);
+}
+
+std::string SerializerGenerator::templateArgs(const std::string& args) {
+  // unchecked variants, once the unit's size was checked up front
+  std::string all = args;
+  if (presized_) all += all.empty() ? "false" : ", false";
+  return all.empty() ? "" : "<" + all + ">";
+}
+
 std::string SerializerGenerator::addTemp(std::string type) {
   auto name = newTempVarName();
   temp_vars_.push_back(std::make_pair(name, type));
   return name;
 }
 
+std::string SerializerGenerator::addConstant(const std::string& bytes) {
+  for (auto c : consts_) {
+    if (c.second == bytes) return c.first;
+  }
+  auto name = util::fmt("const%i", consts_.size() + 1);
+  consts_.push_back(std::make_pair(name, bytes));
+  return name;
+}
+
 void SerializerGenerator::emitInitInstruction(const std::string& instr_label) {
+  // batches restart at unit boundaries, they never resume at an instruction
+  if (batch_) return;
   code_->addLine(instr_label + ":");
   code_->addLine(util::fmt("state->advanceToInstruction(&&%s);", instr_label));
 }
 
+void SerializerGenerator::emitWireOffset(
+    node_ptr<ast::type::unit::item::Item> item, size_t offset) {
+  // records where &patchable fields are in the output, like the parser does
+  // for the input, e.g. for a SharedMessage's patch slots. gather lists have
+  // no contiguous output, and batches no per-message start.
+  if (gather_ || batch_ || !item->attributes()->has("patchable")) return;
+  auto pos = offset ? util::fmt("*POS - out_buf_start + %d", offset)
+                    : std::string("*POS - out_buf_start");
+  code_->addLine(util::fmt(
+      "%s->%s = static_cast<uint32_t>(%s);", exprCurrentUnit(),
+      translator_.unitWireOffsetName(item->id()->name()), pos));
+}
+
 void SerializerGenerator::emitCheckSerializeResult() {
+  // the output buffer's size was checked up front
+  if (presized_) return;
   code_->addLine(
       "if (serialize_res != dr::serializing::SerializeResult::DONE)");
   code_->addLine("  return serialize_res;");
 }
 
+void SerializerGenerator::emitCopyBytes(const std::string& type,
+                                        const std::string& data_member) {
+  auto data = util::fmt("(*((%s*) serialize_src)).%s", type, data_member);
+  auto len = util::fmt("(*((%s*) serialize_src)).len_", type);
+  if (gather_) {
+    code_->addLine(util::fmt(
+        "serialize_res = dr::serializing::util::gatherBytes(%s, %s, gather, "
+        "POS, out_buf_end);",
+        data, len));
+  } else {
+    code_->addLine(util::fmt(
+        "serialize_res = dr::serializing::util::copyBytes%s(%s, %s, POS, "
+        "out_buf_end);",
+        templateArgs(), data, len));
+  }
+}
+
+void SerializerGenerator::emitTransformEncode(
+    node_ptr<ast::type::unit::item::Item> item) {
+  auto attr = item->attributes()->lookup("transform");
+  auto transform = ast::tryCast<ast::expression::Transform>(attr->value());
+  if (!transform) {
+    log(pantheios::error, item, "unresolved transform");
+    return;
+  }
+
+  code_->addLine(util::fmt("serialize_src = reinterpret_cast<char*>(&%s->%s);",
+                           exprCurrentUnit(),
+                           translator_.unitFieldName(item->id()->name())));
+  code_->addLine(util::fmt(
+      "serialize_res = %s::encode(serialize_src, POS, out_buf_end);",
+      translator_.transformName(transform->transform()->id()->name())));
+  emitCheckSerializeResult();
+}
+
 void SerializerGenerator::emitPushBlockState() {
   code_->addLine("state->push<BlockState>();");
   // TODO(ES): initialization of block state members?
@@ -508,10 +1514,10 @@ std::string SerializerGenerator::newTempVarName() {
 }
 
 std::string SerializerGenerator::byteOrderLabel(
-    const node_ptr<spec::ast::type::Integer>& node) {
-  auto bo_prop =
-      current<spec::ast::type::unit::item::Item>()->inheritedProperty(
-          "byteorder");
+    const node_ptr<spec::ast::type::Integer>& node,
+    node_ptr<spec::ast::type::unit::item::Item> item) {
+  if (!item) item = current<spec::ast::type::unit::item::Item>();
+  auto bo_prop = item->inheritedProperty("byteorder");
   if (!bo_prop) {
     log(pantheios::warning, node,
         "missing byteorder specification, assuming big");
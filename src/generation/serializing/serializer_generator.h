@@ -31,8 +31,10 @@
 #include <kode/code.h>
 #include <kode/membervariable.h>
 #include <list>
+#include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "generation/output/translator.h"
 #include "spec/ast/node.h"
@@ -58,8 +60,11 @@ class SerializerGenerator : public spec::ast::Visitor<> {
   SerializerGenerator();
   virtual ~SerializerGenerator();
 
+  /// Generates the serializer of a unit into serializer_cls, and its builder
+  /// into builder_cls. Units without a builder leave builder_cls empty.
   bool run(node_ptr<spec::ast::type::unit::Unit> node,
-           KODE::Class* serializer_cls, const Options& options);
+           KODE::Class* serializer_cls, KODE::Class* builder_cls,
+           const Options& options);
 
   using Visitor::visit;
 
@@ -103,8 +108,7 @@ class SerializerGenerator : public spec::ast::Visitor<> {
  private:
   KODE::Class* cls_ = nullptr;
   KODE::Code* code_ = nullptr;
-  KODE::Code* init_consts_code_ = nullptr;
-  std::list<KODE::MemberVariable> consts_;
+  std::list<std::pair<std::string, std::string>> consts_;
   std::list<std::pair<std::string, std::string>> temp_vars_;
   std::string root_instr_;
 
@@ -116,21 +120,117 @@ class SerializerGenerator : public spec::ast::Visitor<> {
   output::Translator translator_;
 
   bool use_input_pointer_ = false;
+  bool gather_ = false;
+  bool batch_ = false;
+  bool presized_ = false;
+  bool has_files_ = false;  // unit has &file fields, see FileSegments
   const Options* options_ = nullptr;
 
+  /// Generates the static serializedSize() function, which returns the exact
+  /// number of bytes serialize() writes for a unit.
+  void generateSizeFunction();
+
+  enum class Mode {
+    Single,  // serialize(): one unit into an output buffer
+    Batch,   // serializeBatch(): many units back to back into one buffer
+    Gather   // serializeGather(): large bytes fields referenced in a GatherList
+  };
+
+  void generateSerializeFunction(Mode mode);
+  bool hasFileFields(const spec::ast::unit_item_list& items);
+
+  /// Generates serializeTemplate(), which instantiates a WireTemplate by
+  /// copying it and writing the fields at fixed offsets that vary.
+  void generateTemplateFunction();
+
+  /// A &patchable field with its width. Fields within switch cases are only
+  /// present if the guard (on the cases' indices) holds.
+  struct PatchableField {
+    node_ptr<spec::ast::type::unit::item::field::Field> field;
+    size_t width;
+    std::string guard;
+  };
+  /// &patchable fields in wire order.
+  std::vector<PatchableField> patchable_fields_;
+
+  void collectPatchableFields(node_ptr<spec::ast::type::unit::item::Item> item,
+                              const std::string& guard = std::string());
+  /// Generates a static patch_<field>() function for a &patchable field,
+  /// which overwrites the field in the message it was parsed from. Fields of
+  /// switch cases that weren't parsed are refused with INVALID_UNIT.
+  void generatePatchFunction(const PatchableField& patchable);
+  /// Generates forward(), which builds a GatherList of a parsed message that
+  /// references the input except for rewritten &patchable fields.
+  void generateForwardFunction();
+
+  /// Generates the builder class, which writes a unit's fields in wire order
+  /// straight into an output buffer and backpatches length fields at
+  /// finish(). Units it can't build incrementally don't get one.
+  void generateBuilderClass();
+  void collectDerivedFields(const spec::ast::unit_item_list& items);
+  bool builderItems(const spec::ast::unit_item_list& items,
+                    const std::vector<std::string>& case_assigns,
+                    std::vector<size_t>* pending);
+  void closeBuilderGroup(std::vector<size_t>* pending);
+
+  // builder generation state. fields written as a group before the next
+  // setter are filled in by a private fill<N>() function.
+  KODE::Class* builder_ = nullptr;
+  KODE::Code builder_group_;
+  size_t builder_group_width_ = 0;
+  size_t builder_groups_ = 0;
+  std::set<std::string> builder_derived_;
+  std::vector<
+      std::pair<node_ptr<spec::ast::type::unit::item::field::Field>, size_t>>
+      builder_patches_;
+
   void serialize(node_ptr<spec::ast::type::unit::item::Item> item);
   void updateLengthForField(
       node_ptr<spec::ast::type::unit::item::field::Field> field);
 
+  /// A run of fixed-size fields with their widths, which is serialized as one
+  /// block with a single bounds check and a few wide stores.
+  typedef std::vector<
+      std::pair<node_ptr<spec::ast::type::unit::item::field::Field>, size_t>>
+      FixedBlock;
+
+  bool fixedBlockField(node_ptr<spec::ast::type::unit::item::Item> item,
+                       size_t* width);
+  bool fixedSwitchWidth(node_ptr<spec::ast::type::unit::item::Item> item,
+                        size_t* width);
+  void flushFixedBlock(FixedBlock* block);
+  void emitFixedBlock(const FixedBlock& block);
+
+  void emitItemSize(node_ptr<spec::ast::type::unit::item::Item> item);
+  /// Sets the case index of switches over an expression from the expression
+  /// and checks the recorded index of look-ahead switches, before the unit's
+  /// size is computed from them.
+  void emitCaseSelection(node_ptr<spec::ast::type::unit::item::Item> item);
+  void emitInvalidUnit();
+  std::string wireBitsExpr(
+      node_ptr<spec::ast::type::unit::item::field::Field> field,
+      std::string value = std::string());
+  bool serializedConstant(
+      node_ptr<spec::ast::type::unit::item::field::Constant> node,
+      std::string* bytes);
+  std::string templateArgs(const std::string& args = std::string());
+
   std::string addTemp(std::string type);
+  std::string addConstant(const std::string& bytes);
 
   void emitInitInstruction(const std::string& instr_label);
   void emitCheckSerializeResult();
+  void emitWireOffset(node_ptr<spec::ast::type::unit::item::Item> item,
+                      size_t offset);
+  void emitCopyBytes(const std::string& type, const std::string& data_member);
+  void emitTransformEncode(node_ptr<spec::ast::type::unit::item::Item> item);
   void emitPushBlockState();
 
   std::string newInstructionLabel(std::string label_desc = std::string());
   std::string newTempVarName();
-  std::string byteOrderLabel(const node_ptr<spec::ast::type::Integer>& node);
+  std::string byteOrderLabel(
+      const node_ptr<spec::ast::type::Integer>& node,
+      node_ptr<spec::ast::type::unit::item::Item> item = nullptr);
   std::string exprCurrentUnit();
   std::string exprCurrentUnitPP();
 };
@@ -81,6 +81,14 @@ bool process_command_line(int argc, char** argv,
         ("store_parsing_only,s",
          po::bool_switch(&options->store_parsing_only)->default_value(true),
          "store parsing-only variable/field values within parsed units")  //
+        ("relative_offsets,r",
+         po::bool_switch(&options->relative_offsets)->default_value(false),
+         "store references within parsed units as 32-bit relative offsets, "
+         "so that their unit areas can be copied and relocated")  //
+        ("gather_serializing,g",
+         po::bool_switch(&options->gather_serializing)->default_value(false),
+         "also generate serializeGather() functions, which reference large "
+         "bytes fields in an iovec list instead of copying them")  //
         ;  // NOLINT
 
     po::variables_map vm;
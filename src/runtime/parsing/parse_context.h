@@ -0,0 +1,99 @@
+/*
+ * parse_context.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SRC_RUNTIME_PARSING_PARSE_CONTEXT_H_
+#define SRC_RUNTIME_PARSING_PARSE_CONTEXT_H_
+
+#include <new>
+
+#include "runtime/parsing/parser_state.h"
+#include "runtime/unit/buffer_pool.h"
+#include "runtime/unit/unit_area.h"
+
+namespace diffingo {
+namespace runtime {
+namespace parsing {
+
+/// UnitArea and ParserState of a connection, backed by buffers from pools.
+/// The buffers are acquired when input arrives and released again once the
+/// connection is idle, i.e. no parse is in progress and its units aren't
+/// needed anymore.
+class ParseContext {
+ public:
+  ParseContext(unit::BufferPool* area_pool, unit::BufferPool* stack_pool)
+      : area_pool_(area_pool), stack_pool_(stack_pool) {}
+  ~ParseContext() { release(); }
+
+  ParseContext(const ParseContext&) = delete;
+  ParseContext& operator=(const ParseContext&) = delete;
+
+  /// Acquires (fresh) buffers unless they are still held. Returns false if
+  /// a pool is exhausted.
+  bool acquire() {
+    if (area_) return true;
+
+    char* area_buf = area_pool_->acquire();
+    if (!area_buf) return false;
+    char* stack_buf = stack_pool_->acquire();
+    if (!stack_buf) {
+      area_pool_->release(area_buf);
+      return false;
+    }
+
+    // the state is placed at the start of its stack buffer
+    area_ = new (area_buf) unit::UnitArea(area_pool_->buffer_size());
+    state_ = new (stack_buf)
+        ParserState(stack_buf + sizeof(ParserState),
+                    stack_pool_->buffer_size() - sizeof(ParserState));
+    return true;
+  }
+
+  /// Returns the buffers to their pools. Invalidates the parsed units.
+  void release() {
+    if (!area_) return;
+    area_pool_->release(reinterpret_cast<char*>(area_));
+    stack_pool_->release(reinterpret_cast<char*>(state_));
+    area_ = nullptr;
+    state_ = nullptr;
+  }
+
+  bool active() const { return area_ != nullptr; }
+
+  unit::UnitArea* area() const { return area_; }
+  ParserState* state() const { return state_; }
+
+ private:
+  unit::BufferPool* area_pool_;
+  unit::BufferPool* stack_pool_;
+  unit::UnitArea* area_ = nullptr;
+  ParserState* state_ = nullptr;
+};
+
+}  // namespace parsing
+}  // namespace runtime
+}  // namespace diffingo
+
+#endif  // SRC_RUNTIME_PARSING_PARSE_CONTEXT_H_
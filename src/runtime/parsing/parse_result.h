@@ -32,10 +32,11 @@ namespace runtime {
 namespace parsing {
 
 enum ParseResult {
-  DONE,         // unit complete, parser state reset
-  NEXT,         // unit complete, parent unit still unfinished
-  OUT_OF_DATA,  // need more data to continue
-  AREA_FULL     // error condition: area space was not large enough for unit
+  DONE,          // unit complete, parser state reset
+  NEXT,          // unit complete, parent unit still unfinished
+  OUT_OF_DATA,   // need more data to continue
+  AREA_FULL,     // error condition: area space was not large enough for unit
+  INVALID_INPUT  // error condition: input does not match the specification
 };
 
 }  // namespace parsing
@@ -33,8 +33,11 @@
 #include <sys/types.h>
 #include <cstdint>
 #include <cstring>
+#include <type_traits>
 
 #include "runtime/parsing/parse_result.h"
+#include "runtime/unit/copy.h"
+#include "runtime/unit/data_type.h"
 #include "runtime/unit/unit_area.h"
 
 namespace diffingo {
@@ -69,11 +72,23 @@ inline ParseResult copyBytes(char** pos_ptr, char* in_buf_end, char* parse_dest,
                              size_t len) {
   if (in_buf_end - *pos_ptr < static_cast<ssize_t>(len))
     return ParseResult::OUT_OF_DATA;
-  memcpy(parse_dest, *pos_ptr, len);
+  unit::copyMemory(parse_dest, *pos_ptr, len);
   *pos_ptr += len;
   return ParseResult::DONE;
 }
 
+/// Copies N bytes into an inline unit::fixed_bytes<N>. N is known at compile
+/// time, so the copy becomes one or a few loads and stores.
+template <size_t N>
+inline ParseResult copyFixedBytes(char** pos_ptr, char* in_buf_end,
+                                  char* parse_dest) {
+  if (in_buf_end - *pos_ptr < static_cast<ssize_t>(N))
+    return ParseResult::OUT_OF_DATA;
+  memcpy(parse_dest, *pos_ptr, N);
+  *pos_ptr += N;
+  return ParseResult::DONE;
+}
+
 inline ParseResult advance(char** pos_ptr, char* in_buf_end, size_t len) {
   if (in_buf_end - *pos_ptr < static_cast<ssize_t>(len))
     return ParseResult::OUT_OF_DATA;
@@ -87,11 +102,112 @@ inline ParseResult allocateCopyBytes(char** pos_ptr, char* in_buf_end,
   if (in_buf_end - *pos_ptr < static_cast<ssize_t>(len))
     return ParseResult::OUT_OF_DATA;
   if (!area->allocate(len, parse_dest)) return ParseResult::AREA_FULL;
-  memcpy(*parse_dest, *pos_ptr, len);
+  unit::copyMemory(*parse_dest, *pos_ptr, len);
+  *pos_ptr += len;
+  return ParseResult::DONE;
+}
+
+inline ParseResult allocateCopyBytes(char** pos_ptr, char* in_buf_end,
+                                     unit::rel_ptr<char>* parse_dest,
+                                     size_t len, unit::UnitArea* area) {
+  char* dest;
+  auto res = allocateCopyBytes(pos_ptr, in_buf_end, &dest, len, area);
+  if (res == ParseResult::DONE) *parse_dest = dest;
+  return res;
+}
+
+/// Copies dest->len_ bytes into an inline_bytes or inline_string. They are
+/// stored inline if they fit, and allocated from the area otherwise.
+template <typename InlineBytesT>
+inline ParseResult allocateCopyInlineBytes(char** pos_ptr, char* in_buf_end,
+                                           InlineBytesT* dest,
+                                           unit::UnitArea* area) {
+  if (dest->len_ <= InlineBytesT::kCapacity) {
+    dest->data_ = dest->inline_;
+    return copyBytes(pos_ptr, in_buf_end, dest->inline_, dest->len_);
+  }
+  return allocateCopyBytes(pos_ptr, in_buf_end, &dest->data_, dest->len_,
+                           area);
+}
+
+/// Like allocateCopyBytes, but takes the bytes from a region that was
+/// allocated for the whole message up front. *carve_pos points to the next
+/// free byte of that region and is advanced past the copied bytes.
+inline ParseResult carveCopyBytes(char** pos_ptr, char* in_buf_end,
+                                  char** parse_dest, size_t len,
+                                  char** carve_pos) {
+  if (in_buf_end - *pos_ptr < static_cast<ssize_t>(len))
+    return ParseResult::OUT_OF_DATA;
+  *parse_dest = *carve_pos;
+  *carve_pos += len;
+  unit::copyMemory(*parse_dest, *pos_ptr, len);
   *pos_ptr += len;
   return ParseResult::DONE;
 }
 
+inline ParseResult carveCopyBytes(char** pos_ptr, char* in_buf_end,
+                                  unit::rel_ptr<char>* parse_dest, size_t len,
+                                  char** carve_pos) {
+  char* dest;
+  auto res = carveCopyBytes(pos_ptr, in_buf_end, &dest, len, carve_pos);
+  if (res == ParseResult::DONE) *parse_dest = dest;
+  return res;
+}
+
+/// Like allocateCopyInlineBytes, but values that don't fit inline are taken
+/// from a region allocated up front (see carveCopyBytes).
+template <typename InlineBytesT>
+inline ParseResult carveCopyInlineBytes(char** pos_ptr, char* in_buf_end,
+                                        InlineBytesT* dest, char** carve_pos) {
+  if (dest->len_ <= InlineBytesT::kCapacity) {
+    dest->data_ = dest->inline_;
+    return copyBytes(pos_ptr, in_buf_end, dest->inline_, dest->len_);
+  }
+  return carveCopyBytes(pos_ptr, in_buf_end, &dest->data_, dest->len_,
+                        carve_pos);
+}
+
+namespace detail {
+
+template <typename W>
+inline W loadWord(const char* p) {
+  W w;
+  memcpy(&w, p, sizeof(W));
+  return w;
+}
+
+// Compares N bytes. Up to 16 bytes are compared by xor-ing two (possibly
+// overlapping) word-sized loads from each side, so that comparing against a
+// constant compiles to a few loads and immediate compares.
+template <size_t N>
+inline bool equalBytes(const char* a, const char* b) {
+  typedef typename std::conditional<
+      (N >= 8), uint64_t,
+      typename std::conditional<
+          (N >= 4), uint32_t,
+          typename std::conditional<(N >= 2), uint16_t, uint8_t>::type>::
+          type>::type W;
+  if (N == 0) return true;
+  if (N > 2 * sizeof(uint64_t)) return memcmp(a, b, N) == 0;
+  W head = loadWord<W>(a) ^ loadWord<W>(b);
+  W tail = loadWord<W>(a + N - sizeof(W)) ^ loadWord<W>(b + N - sizeof(W));
+  return (head | tail) == 0;
+}
+
+}  // namespace detail
+
+/// Matches the next N bytes of input against a constant in serialized form.
+template <size_t N>
+inline ParseResult matchConstant(char** pos_ptr, char* in_buf_end,
+                                 const char* constant) {
+  if (in_buf_end - *pos_ptr < static_cast<ssize_t>(N))
+    return ParseResult::OUT_OF_DATA;
+  if (!detail::equalBytes<N>(*pos_ptr, constant))
+    return ParseResult::INVALID_INPUT;
+  *pos_ptr += N;
+  return ParseResult::DONE;
+}
+
 // unsigned integers - big endian
 inline ParseResult parseInt8_unsigned_big(char** pos_ptr, char* in_buf_end,
                                           char* parse_dest);
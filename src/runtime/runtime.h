@@ -28,11 +28,21 @@
 #define SRC_RUNTIME_RUNTIME_H_
 
 
+#include "runtime/parsing/parse_context.h"
 #include "runtime/parsing/parse_result.h"
 #include "runtime/parsing/parser_state.h"
 #include "runtime/parsing/util.h"
+#include "runtime/serializing/file_segments.h"
+#include "runtime/serializing/gather_list.h"
+#include "runtime/serializing/message_patcher.h"
 #include "runtime/serializing/serialize_result.h"
+#include "runtime/serializing/shared_message.h"
 #include "runtime/serializing/util.h"
+#include "runtime/serializing/wire_template.h"
+#include "runtime/transform/ascii_integer.h"
+#include "runtime/unit/buffer_pool.h"
+#include "runtime/unit/copy.h"
+#include "runtime/unit/ring_area.h"
 #include "runtime/unit/unit.h"
 #include "runtime/unit/unit_area.h"
 #include "runtime/unit/data_type.h"
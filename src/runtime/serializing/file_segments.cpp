@@ -0,0 +1,93 @@
+/*
+ * file_segments.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "runtime/serializing/file_segments.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+namespace diffingo {
+namespace runtime {
+namespace serializing {
+
+namespace {
+
+bool wouldBlock() {
+#if EAGAIN != EWOULDBLOCK
+  return errno == EAGAIN || errno == EWOULDBLOCK;
+#else
+  return errno == EAGAIN;
+#endif
+}
+
+}  // namespace
+
+int FileSender::send(int out_fd) {
+  while (true) {
+    // buffer bytes up to the next segment, or the end of the message
+    size_t end = segment_ < count_ ? segments_[segment_].pos : len_;
+    if (buf_pos_ < end) {
+      ssize_t n = write(out_fd, buf_ + buf_pos_, end - buf_pos_);
+      if (n < 0) return wouldBlock() ? 0 : -1;
+      buf_pos_ += static_cast<size_t>(n);
+      continue;
+    }
+    if (segment_ == count_) return 1;
+
+    const FileSegments::Segment& segment = segments_[segment_];
+    if (segment_sent_ < segment.len) {
+      ssize_t n = sendRange(out_fd, segment.fd,
+                            segment.offset + static_cast<off_t>(segment_sent_),
+                            segment.len - segment_sent_);
+      if (n < 0) return wouldBlock() ? 0 : -1;
+      if (n == 0) {
+        errno = EIO;
+        return -1;
+      }
+      segment_sent_ += static_cast<size_t>(n);
+      continue;
+    }
+    ++segment_;
+    segment_sent_ = 0;
+  }
+}
+
+ssize_t FileSender::sendRange(int out_fd, int in_fd, off_t offset,
+                              size_t len) {
+  ssize_t n = sendfile(out_fd, in_fd, &offset, len);
+  if (n >= 0 || errno != EINVAL) return n;
+
+  // e.g. pipes on older kernels
+  loff_t in_offset = offset;
+  return splice(in_fd, &in_offset, out_fd, nullptr, len,
+                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+}
+
+}  // namespace serializing
+}  // namespace runtime
+}  // namespace diffingo
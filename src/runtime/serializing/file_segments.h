@@ -0,0 +1,117 @@
+/*
+ * file_segments.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SRC_RUNTIME_SERIALIZING_FILE_SEGMENTS_H_
+#define SRC_RUNTIME_SERIALIZING_FILE_SEGMENTS_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "runtime/unit/data_type.h"
+
+namespace diffingo {
+namespace runtime {
+namespace serializing {
+
+/// File ranges of a unit with file-backed (&file) fields. The serializer
+/// writes all other fields into its output buffer as usual, and records each
+/// file range as a segment at its position in the buffer. The message is the
+/// buffer with the segments' file contents inserted, which a FileSender sends
+/// without copying them through user space.
+class FileSegments {
+ public:
+  struct Segment {
+    size_t pos;  // offset in the output buffer
+    int fd;
+    off_t offset;
+    size_t len;
+  };
+
+  FileSegments(Segment* segments, size_t capacity)
+      : segments_(segments), capacity_(capacity) {}
+
+  void clear() {
+    count_ = 0;
+    length_ = 0;
+  }
+
+  /// Appends a segment at pos. Returns false if the segment array is full.
+  bool add(size_t pos, const unit::file_range& range) {
+    if (range.len_ == 0) return true;
+    if (count_ == capacity_) return false;
+    segments_[count_++] = Segment{pos, range.fd_, range.offset_, range.len_};
+    length_ += range.len_;
+    return true;
+  }
+
+  const Segment* segments() const { return segments_; }
+  size_t count() const { return count_; }
+  /// Total number of bytes in the file ranges.
+  size_t length() const { return length_; }
+
+ private:
+  Segment* segments_;
+  size_t capacity_;
+  size_t count_ = 0;
+  size_t length_ = 0;
+};
+
+/// Sends a serialized message with its file segments to a socket or pipe.
+/// Buffer bytes are written, file ranges are transferred with sendfile(), or
+/// splice() where sendfile() doesn't support the descriptors. send() can be
+/// called repeatedly on a non-blocking descriptor, and continues where the
+/// last call stopped.
+class FileSender {
+ public:
+  FileSender(const char* buf, size_t len, const FileSegments& segments)
+      : buf_(buf),
+        len_(len),
+        segments_(segments.segments()),
+        count_(segments.count()) {}
+
+  /// Returns 1 once the whole message was sent, 0 if out_fd would block, and
+  /// -1 on errors (see errno). A file that ends before its range is an
+  /// error (EIO).
+  int send(int out_fd);
+
+ private:
+  const char* buf_;
+  size_t len_;
+  const FileSegments::Segment* segments_;
+  size_t count_;
+
+  size_t buf_pos_ = 0;       // bytes of the buffer sent
+  size_t segment_ = 0;       // next segment
+  size_t segment_sent_ = 0;  // bytes of the next segment sent
+
+  static ssize_t sendRange(int out_fd, int in_fd, off_t offset, size_t len);
+};
+
+}  // namespace serializing
+}  // namespace runtime
+}  // namespace diffingo
+
+#endif  // SRC_RUNTIME_SERIALIZING_FILE_SEGMENTS_H_
@@ -0,0 +1,139 @@
+/*
+ * gather_list.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SRC_RUNTIME_SERIALIZING_GATHER_LIST_H_
+#define SRC_RUNTIME_SERIALIZING_GATHER_LIST_H_
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+namespace diffingo {
+namespace runtime {
+namespace serializing {
+
+/// Output of a gather serializer (serializeGather()), which can be passed to
+/// writev() or sendmsg() directly. Small fields (headers, integers,
+/// constants) are serialized into a scratch buffer, while large bytes fields
+/// become iovec entries that reference the unit's data or the original input
+/// range, so they are never copied. Referenced data has to stay valid until
+/// the list was written.
+class GatherList {
+ public:
+  static const size_t kDefaultMinReferenceLength = 256;
+
+  GatherList(struct iovec* iov, size_t capacity, char* scratch,
+             size_t scratch_size,
+             size_t min_reference_length = kDefaultMinReferenceLength)
+      : iov_(iov),
+        capacity_(capacity),
+        scratch_start_(scratch),
+        scratch_end_(scratch + scratch_size),
+        min_reference_length_(min_reference_length) {
+    clear();
+  }
+
+  void clear() {
+    count_ = 0;
+    length_ = 0;
+    mark_ = scratch_start_;
+  }
+
+  char* scratchStart() const { return scratch_start_; }
+  char* scratchEnd() const { return scratch_end_; }
+
+  /// Whether a field of len bytes should be referenced rather than copied
+  /// into the scratch buffer, where an extra iovec entry isn't worth it.
+  bool referenceable(size_t len) const { return len >= min_reference_length_; }
+
+  /// Appends a reference to len bytes at data, after the scratch bytes that
+  /// were serialized since the last entry, up to pos. Returns false if the
+  /// iovec array is full.
+  bool addReference(char* pos, char* data, size_t len) {
+    size_t entries = 0;
+    if (pos > mark_) ++entries;
+    if (len > 0 && (pos > mark_ || !extendsLast(data))) ++entries;
+    if (count_ + entries > capacity_) return false;
+    addScratch(pos);
+    addEntry(data, len);
+    return true;
+  }
+
+  /// Appends the remaining scratch bytes, up to pos. Returns false if the
+  /// iovec array is full.
+  bool finish(char* pos) {
+    if (pos > mark_ && !extendsLast(mark_) && count_ == capacity_)
+      return false;
+    addScratch(pos);
+    return true;
+  }
+
+  const struct iovec* iov() const { return iov_; }
+  size_t count() const { return count_; }
+  /// Total number of bytes referenced by the list.
+  size_t length() const { return length_; }
+
+ private:
+  struct iovec* iov_;
+  size_t capacity_;
+  size_t count_;
+  size_t length_;
+
+  char* scratch_start_;
+  char* scratch_end_;
+  char* mark_;  // start of scratch bytes not yet in the list
+
+  size_t min_reference_length_;
+
+  void addScratch(char* pos) {
+    addEntry(mark_, static_cast<size_t>(pos - mark_));
+    mark_ = pos;
+  }
+
+  bool extendsLast(char* data) const {
+    if (count_ == 0) return false;
+    const struct iovec& last = iov_[count_ - 1];
+    return static_cast<char*>(last.iov_base) + last.iov_len == data;
+  }
+
+  void addEntry(char* data, size_t len) {
+    if (len == 0) return;
+    length_ += len;
+    if (extendsLast(data)) {
+      // contiguous with the previous entry
+      iov_[count_ - 1].iov_len += len;
+      return;
+    }
+    iov_[count_].iov_base = data;
+    iov_[count_].iov_len = len;
+    ++count_;
+  }
+};
+
+}  // namespace serializing
+}  // namespace runtime
+}  // namespace diffingo
+
+#endif  // SRC_RUNTIME_SERIALIZING_GATHER_LIST_H_
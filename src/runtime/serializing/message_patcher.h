@@ -0,0 +1,93 @@
+/*
+ * message_patcher.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef SRC_RUNTIME_SERIALIZING_MESSAGE_PATCHER_H_
+#define SRC_RUNTIME_SERIALIZING_MESSAGE_PATCHER_H_
+
+#include <stddef.h>
+
+#include "runtime/serializing/gather_list.h"
+#include "runtime/serializing/serialize_result.h"
+
+namespace diffingo {
+namespace runtime {
+namespace serializing {
+
+/// Builds the gather list of a parsed message with some fields rewritten, for
+/// the generated forward(). Unchanged ranges reference the message, rewritten
+/// fields are written into the gather list's scratch buffer. Fields have to be
+/// patched in wire order.
+class MessagePatcher {
+ public:
+  MessagePatcher(char* msg, size_t msg_len, GatherList* gather)
+      : msg_(msg),
+        msg_len_(msg_len),
+        gather_(gather),
+        pos_(gather->scratchStart()),
+        in_offset_(0) {
+    gather->clear();
+  }
+
+  /// Replaces the width bytes at offset in the message. On success, *dest
+  /// points to the scratch bytes the new value has to be written to. Fails
+  /// with INVALID_UNIT if the field overlaps an earlier one or isn't within
+  /// the message, i.e. if the unit's recorded wire offset is wrong.
+  SerializeResult patch(size_t offset, size_t width, char** dest) {
+    if (offset < in_offset_ || offset > msg_len_ ||
+        width > msg_len_ - offset)
+      return SerializeResult::INVALID_UNIT;
+    if (static_cast<size_t>(gather_->scratchEnd() - pos_) < width ||
+        !gather_->addReference(pos_, msg_ + in_offset_, offset - in_offset_))
+      return SerializeResult::OUT_BUF_FULL;
+    *dest = pos_;
+    pos_ += width;
+    in_offset_ = offset + width;
+    return SerializeResult::DONE;
+  }
+
+  /// Appends the rest of the message after the last patched field.
+  SerializeResult finish() {
+    if (!gather_->addReference(pos_, msg_ + in_offset_,
+                               msg_len_ - in_offset_) ||
+        !gather_->finish(pos_))
+      return SerializeResult::OUT_BUF_FULL;
+    return SerializeResult::DONE;
+  }
+
+ private:
+  char* msg_;
+  size_t msg_len_;
+  GatherList* gather_;
+  char* pos_;         // next scratch byte
+  size_t in_offset_;  // start of the message bytes not yet in the list
+};
+
+}  // namespace serializing
+}  // namespace runtime
+}  // namespace diffingo
+
+#endif  // SRC_RUNTIME_SERIALIZING_MESSAGE_PATCHER_H_
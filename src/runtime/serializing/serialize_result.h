@@ -34,7 +34,11 @@ namespace serializing {
 enum SerializeResult {
   DONE,         // unit complete, parser state reset
   NEXT,         // unit complete, parent unit still unfinished
-  OUT_BUF_FULL  // error condition: output buffer was not large enough for unit
+  OUT_BUF_FULL,  // error condition: output buffer (or gather list) was not
+                 // large enough for unit
+  INVALID_UNIT   // error condition: the unit's values are inconsistent, e.g.
+                 // a switch has no valid case or a wire offset is outside of
+                 // the message
 };
 
 }  // namespace serializing
@@ -0,0 +1,167 @@
+/*
+ * shared_message.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SRC_RUNTIME_SERIALIZING_SHARED_MESSAGE_H_
+#define SRC_RUNTIME_SERIALIZING_SHARED_MESSAGE_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include "runtime/parsing/parser_state.h"
+#include "runtime/serializing/gather_list.h"
+#include "runtime/serializing/serialize_result.h"
+
+namespace diffingo {
+namespace runtime {
+namespace serializing {
+
+/// A message that is serialized once and sent to several destinations, such
+/// as a SET replicated to multiple backends. The encoded bytes are stored
+/// right after the reference-counted object, in a single allocation, and
+/// never change after encode().
+///
+/// Fields that differ per destination (e.g. opaque or vbucket_id) are
+/// declared as patch slots at their offsets in the message. A serializer
+/// records the offsets of &patchable fields in the unit's <field>_offset
+/// members. gather() then references the shared bytes from a GatherList,
+/// and only copies the destination's values of the slots into the list's
+/// scratch buffer.
+class SharedMessage {
+ public:
+  static const size_t kMaxSlots = 8;
+
+  /// Returns a message for up to capacity bytes, with one reference.
+  static SharedMessage* create(size_t capacity) {
+    void* mem = ::operator new(sizeof(SharedMessage) + capacity);
+    return new (mem) SharedMessage(capacity);
+  }
+
+  SharedMessage(const SharedMessage&) = delete;
+  SharedMessage& operator=(const SharedMessage&) = delete;
+
+  void ref() { refs_.fetch_add(1, std::memory_order_relaxed); }
+
+  /// Drops a reference, and frees the message with the last one.
+  void unref() {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      this->~SharedMessage();
+      ::operator delete(this);
+    }
+  }
+
+  /// Serializes unit into the message, using the serializer's serialize().
+  /// Clears the patch slots.
+  template <typename Serializer>
+  SerializeResult encode(Serializer* serializer, char* unit,
+                         parsing::ParserState* state) {
+    size_ = 0;
+    num_slots_ = 0;
+    state->reset();
+    size_t size;
+    auto res =
+        serializer->serialize(unit, data(), data() + capacity_, state, &size);
+    if (res == SerializeResult::DONE) size_ = size;
+    return res;
+  }
+
+  /// Declares len bytes at offset as a patch slot. Slots have to be added in
+  /// increasing order of their offsets and must not overlap. Returns false
+  /// otherwise, or if there are too many slots.
+  bool addSlot(size_t offset, size_t len) {
+    if (num_slots_ == kMaxSlots || offset + len > size_) return false;
+    if (num_slots_ > 0 &&
+        offset < slots_[num_slots_ - 1].offset + slots_[num_slots_ - 1].len)
+      return false;
+    slots_[num_slots_].offset = offset;
+    slots_[num_slots_].len = len;
+    ++num_slots_;
+    return true;
+  }
+
+  /// Fills gather with the message, with the patch slots replaced by the
+  /// destination's values in patch (back to back, in slot order; see
+  /// patchSize()). Unpatched ranges reference the shared bytes, so the
+  /// message has to be kept referenced until the list was written. Returns
+  /// false if the list's iovec array or scratch buffer is full.
+  bool gather(GatherList* gather, const char* patch) const {
+    char* pos = gather->scratchStart();
+    char* in_pos = data();
+    gather->clear();
+
+    for (size_t i = 0; i < num_slots_; ++i) {
+      const Slot& slot = slots_[i];
+      char* slot_start = data() + slot.offset;
+      if (static_cast<size_t>(gather->scratchEnd() - pos) < slot.len ||
+          !gather->addReference(pos, in_pos,
+                                static_cast<size_t>(slot_start - in_pos)))
+        return false;
+      memcpy(pos, patch, slot.len);
+      pos += slot.len;
+      patch += slot.len;
+      in_pos = slot_start + slot.len;
+    }
+    return gather->addReference(pos, in_pos,
+                                static_cast<size_t>(data() + size_ - in_pos)) &&
+           gather->finish(pos);
+  }
+
+  char* data() const {
+    return const_cast<char*>(reinterpret_cast<const char*>(this + 1));
+  }
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  size_t numSlots() const { return num_slots_; }
+  /// Number of bytes of a destination's patch values.
+  size_t patchSize() const {
+    size_t size = 0;
+    for (size_t i = 0; i < num_slots_; ++i) size += slots_[i].len;
+    return size;
+  }
+
+ private:
+  struct Slot {
+    size_t offset;
+    size_t len;
+  };
+
+  explicit SharedMessage(size_t capacity) : refs_(1), capacity_(capacity) {}
+  ~SharedMessage() {}
+
+  std::atomic<uint32_t> refs_;
+  size_t capacity_;
+  size_t size_ = 0;
+  Slot slots_[kMaxSlots];
+  size_t num_slots_ = 0;
+};
+
+}  // namespace serializing
+}  // namespace runtime
+}  // namespace diffingo
+
+#endif  // SRC_RUNTIME_SERIALIZING_SHARED_MESSAGE_H_
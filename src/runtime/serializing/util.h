@@ -33,18 +33,26 @@
 #include <sys/types.h>
 #include <cstdint>
 #include <cstring>
+#include <type_traits>
 
+#include "runtime/serializing/gather_list.h"
 #include "runtime/serializing/serialize_result.h"
+#include "runtime/unit/copy.h"
 
 namespace diffingo {
 namespace runtime {
 namespace serializing {
 namespace util {
 
-template <typename T>
+// The serialize functions check that the output buffer has enough space for
+// the value, unless Check is false because the serializer checked the size of
+// the whole unit up front (see the generated serializedSize()).
+
+template <typename T, bool Check = true>
 inline SerializeResult copyAtomicType(char* serialize_src, char** pos_ptr,
                                       char* out_buf_end) {
-  if (out_buf_end - *pos_ptr < sizeof(T)) return SerializeResult::OUT_BUF_FULL;
+  if (Check && out_buf_end - *pos_ptr < sizeof(T))
+    return SerializeResult::OUT_BUF_FULL;
   *reinterpret_cast<T*>(*pos_ptr) = *reinterpret_cast<T*>(serialize_src);
   *pos_ptr += sizeof(T);
   return SerializeResult::DONE;
@@ -65,67 +73,115 @@ parse_dest,
 }
 */
 
+template <bool Check = true>
 inline SerializeResult copyBytes(char* serialize_src, size_t len,
                                  char** pos_ptr, char* out_buf_end) {
-  if (out_buf_end - *pos_ptr < static_cast<ssize_t>(len))
+  if (Check && out_buf_end - *pos_ptr < static_cast<ssize_t>(len))
     return SerializeResult::OUT_BUF_FULL;
-  memcpy(*pos_ptr, serialize_src, len);
+  unit::copyMemory(*pos_ptr, serialize_src, len);
   *pos_ptr += len;
   return SerializeResult::DONE;
 }
 
+/// Adds len bytes at serialize_src to a gather list: large fields are
+/// referenced in place, small ones copied into the scratch buffer.
+inline SerializeResult gatherBytes(char* serialize_src, size_t len,
+                                   GatherList* gather, char** pos_ptr,
+                                   char* out_buf_end) {
+  if (!gather->referenceable(len))
+    return copyBytes(serialize_src, len, pos_ptr, out_buf_end);
+  if (!gather->addReference(*pos_ptr, serialize_src, len))
+    return SerializeResult::OUT_BUF_FULL;
+  return SerializeResult::DONE;
+}
+
+/// Writes a constant of N bytes in serialized form. N is known at compile
+/// time, so the copy becomes one or a few stores.
+template <size_t N, bool Check = true>
+inline SerializeResult copyConstant(const char* constant, char** pos_ptr,
+                                    char* out_buf_end) {
+  if (Check && out_buf_end - *pos_ptr < static_cast<ssize_t>(N))
+    return SerializeResult::OUT_BUF_FULL;
+  memcpy(*pos_ptr, constant, N);
+  *pos_ptr += N;
+  return SerializeResult::DONE;
+}
+
+/// Writes the N bytes of an inline unit::fixed_bytes<N>.
+template <size_t N, bool Check = true>
+inline SerializeResult copyFixedBytes(char* serialize_src, char** pos_ptr,
+                                      char* out_buf_end) {
+  return copyConstant<N, Check>(serialize_src, pos_ptr, out_buf_end);
+}
+
 // unsigned integers - big endian
+template <bool Check = true>
 inline SerializeResult serializeInt8_unsigned_big(char* serialize_src,
                                                   char** pos_ptr,
                                                   char* out_buf_end);
+template <bool Check = true>
 inline SerializeResult serializeInt16_unsigned_big(char* serialize_src,
                                                    char** pos_ptr,
                                                    char* out_buf_end);
+template <bool Check = true>
 inline SerializeResult serializeInt32_unsigned_big(char* serialize_src,
                                                    char** pos_ptr,
                                                    char* out_buf_end);
+template <bool Check = true>
 inline SerializeResult serializeInt64_unsigned_big(char* serialize_src,
                                                    char** pos_ptr,
                                                    char* out_buf_end);
 
 // unsigned integers - little endian
+template <bool Check = true>
 inline SerializeResult serializeInt8_unsigned_little(char* serialize_src,
                                                      char** pos_ptr,
                                                      char* out_buf_end);
+template <bool Check = true>
 inline SerializeResult serializeInt16_unsigned_little(char* serialize_src,
                                                       char** pos_ptr,
                                                       char* out_buf_end);
+template <bool Check = true>
 inline SerializeResult serializeInt32_unsigned_little(char* serialize_src,
                                                       char** pos_ptr,
                                                       char* out_buf_end);
+template <bool Check = true>
 inline SerializeResult serializeInt64_unsigned_little(char* serialize_src,
                                                       char** pos_ptr,
                                                       char* out_buf_end);
 
 // signed integers - big endian
+template <bool Check = true>
 inline SerializeResult serializeInt8_signed_big(char* serialize_src,
                                                 char** pos_ptr,
                                                 char* out_buf_end);
+template <bool Check = true>
 inline SerializeResult serializeInt16_signed_big(char* serialize_src,
                                                  char** pos_ptr,
                                                  char* out_buf_end);
+template <bool Check = true>
 inline SerializeResult serializeInt32_signed_big(char* serialize_src,
                                                  char** pos_ptr,
                                                  char* out_buf_end);
+template <bool Check = true>
 inline SerializeResult serializeInt64_signed_big(char* serialize_src,
                                                  char** pos_ptr,
                                                  char* out_buf_end);
 
 // signed integers - little endian
+template <bool Check = true>
 inline SerializeResult serializeInt8_signed_little(char* serialize_src,
                                                    char** pos_ptr,
                                                    char* out_buf_end);
+template <bool Check = true>
 inline SerializeResult serializeInt16_signed_little(char* serialize_src,
                                                     char** pos_ptr,
                                                     char* out_buf_end);
+template <bool Check = true>
 inline SerializeResult serializeInt32_signed_little(char* serialize_src,
                                                     char** pos_ptr,
                                                     char* out_buf_end);
+template <bool Check = true>
 inline SerializeResult serializeInt64_signed_little(char* serialize_src,
                                                     char** pos_ptr,
                                                     char* out_buf_end);
@@ -136,17 +192,19 @@ inline SerializeResult serializeInt64_signed_little(char* serialize_src,
 
 #if __BYTE_ORDER == __LITTLE_ENDIAN
 
+template <bool Check>
 inline SerializeResult serializeInt8_unsigned_big(char* serialize_src,
                                                   char** pos_ptr,
                                                   char* out_buf_end) {
   // only a single byte -> nothing changes
-  return copyAtomicType<uint8_t>(serialize_src, pos_ptr, out_buf_end);
+  return copyAtomicType<uint8_t, Check>(serialize_src, pos_ptr, out_buf_end);
 }
 
+template <bool Check>
 inline SerializeResult serializeInt16_unsigned_big(char* serialize_src,
                                                    char** pos_ptr,
                                                    char* out_buf_end) {
-  if (out_buf_end - *pos_ptr < sizeof(uint16_t))
+  if (Check && out_buf_end - *pos_ptr < sizeof(uint16_t))
     return SerializeResult::OUT_BUF_FULL;
   *reinterpret_cast<uint16_t*>(*pos_ptr) =
       bswap_16(*reinterpret_cast<uint16_t*>(serialize_src));
@@ -154,10 +212,11 @@ inline SerializeResult serializeInt16_unsigned_big(char* serialize_src,
   return SerializeResult::DONE;
 }
 
+template <bool Check>
 inline SerializeResult serializeInt32_unsigned_big(char* serialize_src,
                                                    char** pos_ptr,
                                                    char* out_buf_end) {
-  if (out_buf_end - *pos_ptr < sizeof(uint32_t))
+  if (Check && out_buf_end - *pos_ptr < sizeof(uint32_t))
     return SerializeResult::OUT_BUF_FULL;
   *reinterpret_cast<uint32_t*>(*pos_ptr) =
       bswap_32(*reinterpret_cast<uint32_t*>(serialize_src));
@@ -165,10 +224,11 @@ inline SerializeResult serializeInt32_unsigned_big(char* serialize_src,
   return SerializeResult::DONE;
 }
 
+template <bool Check>
 inline SerializeResult serializeInt64_unsigned_big(char* serialize_src,
                                                    char** pos_ptr,
                                                    char* out_buf_end) {
-  if (out_buf_end - *pos_ptr < sizeof(uint64_t))
+  if (Check && out_buf_end - *pos_ptr < sizeof(uint64_t))
     return SerializeResult::OUT_BUF_FULL;
   *reinterpret_cast<uint64_t*>(*pos_ptr) =
       bswap_64(*reinterpret_cast<uint64_t*>(serialize_src));
@@ -176,41 +236,47 @@ inline SerializeResult serializeInt64_unsigned_big(char* serialize_src,
   return SerializeResult::DONE;
 }
 
+template <bool Check>
 inline SerializeResult serializeInt8_unsigned_little(char* serialize_src,
                                                      char** pos_ptr,
                                                      char* out_buf_end) {
-  return copyAtomicType<uint8_t>(serialize_src, pos_ptr, out_buf_end);
+  return copyAtomicType<uint8_t, Check>(serialize_src, pos_ptr, out_buf_end);
 }
 
+template <bool Check>
 inline SerializeResult serializeInt16_unsigned_little(char* serialize_src,
                                                       char** pos_ptr,
                                                       char* out_buf_end) {
-  return copyAtomicType<uint16_t>(serialize_src, pos_ptr, out_buf_end);
+  return copyAtomicType<uint16_t, Check>(serialize_src, pos_ptr, out_buf_end);
 }
 
+template <bool Check>
 inline SerializeResult serializeInt32_unsigned_little(char* serialize_src,
                                                       char** pos_ptr,
                                                       char* out_buf_end) {
-  return copyAtomicType<uint32_t>(serialize_src, pos_ptr, out_buf_end);
+  return copyAtomicType<uint32_t, Check>(serialize_src, pos_ptr, out_buf_end);
 }
 
+template <bool Check>
 inline SerializeResult serializeInt64_unsigned_little(char* serialize_src,
                                                       char** pos_ptr,
                                                       char* out_buf_end) {
-  return copyAtomicType<uint64_t>(serialize_src, pos_ptr, out_buf_end);
+  return copyAtomicType<uint64_t, Check>(serialize_src, pos_ptr, out_buf_end);
 }
 
+template <bool Check>
 inline SerializeResult serializeInt8_signed_big(char* serialize_src,
                                                 char** pos_ptr,
                                                 char* out_buf_end) {
   // only a single byte -> nothing changes
-  return copyAtomicType<int8_t>(serialize_src, pos_ptr, out_buf_end);
+  return copyAtomicType<int8_t, Check>(serialize_src, pos_ptr, out_buf_end);
 }
 
+template <bool Check>
 inline SerializeResult serializeInt16_signed_big(char* serialize_src,
                                                  char** pos_ptr,
                                                  char* out_buf_end) {
-  if (out_buf_end - *pos_ptr < sizeof(int16_t))
+  if (Check && out_buf_end - *pos_ptr < sizeof(int16_t))
     return SerializeResult::OUT_BUF_FULL;
   *reinterpret_cast<int16_t*>(*pos_ptr) =
       bswap_16(*reinterpret_cast<int16_t*>(serialize_src));
@@ -218,10 +284,11 @@ inline SerializeResult serializeInt16_signed_big(char* serialize_src,
   return SerializeResult::DONE;
 }
 
+template <bool Check>
 inline SerializeResult serializeInt32_signed_big(char* serialize_src,
                                                  char** pos_ptr,
                                                  char* out_buf_end) {
-  if (out_buf_end - *pos_ptr < sizeof(int32_t))
+  if (Check && out_buf_end - *pos_ptr < sizeof(int32_t))
     return SerializeResult::OUT_BUF_FULL;
   *reinterpret_cast<int32_t*>(*pos_ptr) =
       bswap_32(*reinterpret_cast<int32_t*>(serialize_src));
@@ -229,10 +296,11 @@ inline SerializeResult serializeInt32_signed_big(char* serialize_src,
   return SerializeResult::DONE;
 }
 
+template <bool Check>
 inline SerializeResult serializeInt64_signed_big(char* serialize_src,
                                                  char** pos_ptr,
                                                  char* out_buf_end) {
-  if (out_buf_end - *pos_ptr < sizeof(int64_t))
+  if (Check && out_buf_end - *pos_ptr < sizeof(int64_t))
     return SerializeResult::OUT_BUF_FULL;
   *reinterpret_cast<int64_t*>(*pos_ptr) =
       bswap_64(*reinterpret_cast<int64_t*>(serialize_src));
@@ -240,28 +308,67 @@ inline SerializeResult serializeInt64_signed_big(char* serialize_src,
   return SerializeResult::DONE;
 }
 
+template <bool Check>
 inline SerializeResult serializeInt8_signed_little(char* serialize_src,
                                                    char** pos_ptr,
                                                    char* out_buf_end) {
-  return copyAtomicType<int8_t>(serialize_src, pos_ptr, out_buf_end);
+  return copyAtomicType<int8_t, Check>(serialize_src, pos_ptr, out_buf_end);
 }
 
+template <bool Check>
 inline SerializeResult serializeInt16_signed_little(char* serialize_src,
                                                     char** pos_ptr,
                                                     char* out_buf_end) {
-  return copyAtomicType<int16_t>(serialize_src, pos_ptr, out_buf_end);
+  return copyAtomicType<int16_t, Check>(serialize_src, pos_ptr, out_buf_end);
 }
 
+template <bool Check>
 inline SerializeResult serializeInt32_signed_little(char* serialize_src,
                                                     char** pos_ptr,
                                                     char* out_buf_end) {
-  return copyAtomicType<int32_t>(serialize_src, pos_ptr, out_buf_end);
+  return copyAtomicType<int32_t, Check>(serialize_src, pos_ptr, out_buf_end);
 }
 
+template <bool Check>
 inline SerializeResult serializeInt64_signed_little(char* serialize_src,
                                                     char** pos_ptr,
                                                     char* out_buf_end) {
-  return copyAtomicType<int64_t>(serialize_src, pos_ptr, out_buf_end);
+  return copyAtomicType<int64_t, Check>(serialize_src, pos_ptr, out_buf_end);
+}
+
+// Runs of fixed-size fields are serialized as one block: the fields are
+// assembled into 64-bit words in registers, with byte i of the block at bits
+// 8 * (i % 8) of word i / 8, and written with a single copyConstant().
+
+inline uint8_t byteSwap(uint8_t value) { return value; }
+inline uint16_t byteSwap(uint16_t value) { return bswap_16(value); }
+inline uint32_t byteSwap(uint32_t value) { return bswap_32(value); }
+inline uint64_t byteSwap(uint64_t value) { return bswap_64(value); }
+
+/// Returns the integer's bytes in serialized order, as the low bytes of a
+/// block word.
+template <typename T, bool BigEndian>
+inline uint64_t wireBits(T value) {
+  typedef typename std::make_unsigned<T>::type U;
+  U bits = static_cast<U>(value);
+  return BigEndian ? byteSwap(bits) : bits;
+}
+
+/// Writes the N <= 8 low bytes of a block word, e.g. into a copied
+/// WireTemplate.
+template <size_t N>
+inline void storeBits(char* dest, uint64_t bits) {
+  static_assert(N <= sizeof(uint64_t), "too many bytes for a block word");
+  memcpy(dest, &bits, N);
+}
+
+/// Returns N <= 8 bytes as the low bytes of a block word.
+template <size_t N>
+inline uint64_t bytesBits(const char* src) {
+  static_assert(N <= sizeof(uint64_t), "too many bytes for a block word");
+  uint64_t bits = 0;
+  memcpy(&bits, src, N);
+  return bits;
 }
 
 #elif __BYTE_ORDER == __BIG_ENDIAN
@@ -0,0 +1,85 @@
+/*
+ * wire_template.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SRC_RUNTIME_SERIALIZING_WIRE_TEMPLATE_H_
+#define SRC_RUNTIME_SERIALIZING_WIRE_TEMPLATE_H_
+
+#include <stddef.h>
+#include <cstdint>
+
+#include "runtime/parsing/parser_state.h"
+#include "runtime/serializing/serialize_result.h"
+
+namespace diffingo {
+namespace runtime {
+namespace serializing {
+
+/// A pre-serialized message for near-identical messages, such as memcached
+/// SET acknowledgements that only differ in opaque and cas. The application
+/// records a template unit once, together with the fields that vary (a mask
+/// of the serializer's TemplateFields bits). The generated
+/// serializeTemplate() then copies the template and only writes the unit's
+/// values of these fields.
+///
+/// Only fields at fixed offsets in the message can vary, i.e. those that
+/// have a TemplateFields bit. All other fields, including variable-length
+/// ones, are copied from the template.
+class WireTemplate {
+ public:
+  WireTemplate(char* buffer, size_t capacity)
+      : buffer_(buffer), capacity_(capacity) {}
+
+  /// Serializes unit as the template, using the serializer's serialize().
+  template <typename Serializer>
+  SerializeResult record(Serializer* serializer, char* unit, uint32_t fields,
+                         parsing::ParserState* state) {
+    size_ = 0;
+    state->reset();
+    size_t size;
+    auto res =
+        serializer->serialize(unit, buffer_, buffer_ + capacity_, state, &size);
+    if (res != SerializeResult::DONE) return res;
+    size_ = size;
+    fields_ = fields;
+    return res;
+  }
+
+  const char* data() const { return buffer_; }
+  size_t size() const { return size_; }
+  uint32_t fields() const { return fields_; }
+
+ private:
+  char* buffer_;
+  size_t capacity_;
+  size_t size_ = 0;
+  uint32_t fields_ = 0;
+};
+
+}  // namespace serializing
+}  // namespace runtime
+}  // namespace diffingo
+
+#endif  // SRC_RUNTIME_SERIALIZING_WIRE_TEMPLATE_H_
@@ -0,0 +1,336 @@
+/*
+ * ascii_integer.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef SRC_RUNTIME_TRANSFORM_ASCII_INTEGER_H_
+#define SRC_RUNTIME_TRANSFORM_ASCII_INTEGER_H_
+
+#include <endian.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <cstdint>
+#include <cstring>
+
+#include "runtime/parsing/parse_result.h"
+#include "runtime/serializing/serialize_result.h"
+#include "runtime/unit/data_type.h"
+
+namespace diffingo {
+namespace runtime {
+namespace transform {
+
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+
+#if __BYTE_ORDER != __LITTLE_ENDIAN
+#error big endian system not supported yet
+#endif
+
+// Built-in transforms between ASCII-encoded unsigned integers on the wire and
+// native unsigned integers within units, used by text protocols such as HTTP.
+//
+// Decoding consumes the longest run of digits at the current position. A
+// number is only complete once it is followed by a non-digit character. If the
+// digits extend up to the end of the input buffer, OUT_OF_DATA is returned
+// without consuming any input, so that decoding restarts at the same position
+// once more data has arrived, unless the input is known to be complete (as for
+// values of already parsed fields). Encoding either writes the complete number
+// or nothing at all.
+
+namespace ascii {
+
+// "00" "01" ... "99"
+extern const char kDecimalDigitPairs[200];
+// "0123456789abcdef"
+extern const char kHexDigits[16];
+// 10^0 ... 10^8
+extern const uint64_t kPowersOf10[9];
+
+const uint64_t kOnes = 0x0101010101010101ULL;
+const uint64_t kHighBits = 0x8080808080808080ULL;
+
+inline uint64_t load64(const char* pos) {
+  uint64_t chunk;
+  memcpy(&chunk, pos, sizeof(chunk));
+  return chunk;
+}
+
+// Returns a mask with the high bit set in each byte of the chunk that is not
+// an ASCII decimal digit.
+inline uint64_t nonDecimalMask(uint64_t chunk) {
+  uint64_t x = chunk ^ (kOnes * '0');
+  return (((x & (kOnes * 0x7F)) + kOnes * 0x76) | x) & kHighBits;
+}
+
+// Returns a mask with the high bit set in each byte of the chunk that is not
+// an ASCII hex digit (either case).
+inline uint64_t nonHexMask(uint64_t chunk) {
+  // 'a'..'f' and 'A'..'F' map to 1..6.
+  uint64_t y = (chunk | (kOnes * 0x20)) ^ (kOnes * 0x60);
+  uint64_t y7 = y & (kOnes * 0x7F);
+  uint64_t non_alpha =
+      ((y7 + kOnes * 0x79) | y | ~(y7 + kOnes * 0x7F)) & kHighBits;
+  return nonDecimalMask(chunk) & non_alpha;
+}
+
+// Returns the number of leading bytes of a chunk that are digits, given the
+// chunk's non-digit mask.
+inline int leadingDigits(uint64_t non_digit_mask) {
+  return non_digit_mask ? (__builtin_ctzll(non_digit_mask) >> 3) : 8;
+}
+
+// Converts eight ASCII decimal digits (most significant digit first in
+// memory) to their value. Zero bytes count as leading zeros.
+inline uint64_t decimalChunkValue(uint64_t chunk) {
+  chunk = ((chunk & (kOnes * 0x0F)) * 2561) >> 8;
+  chunk = ((chunk & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+  return ((chunk & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+}
+
+// Converts eight ASCII hex digits (most significant digit first in memory) to
+// their value. Zero bytes count as leading zeros.
+inline uint64_t hexChunkValue(uint64_t chunk) {
+  uint64_t nibbles = (chunk & (kOnes * 0x0F)) + ((chunk >> 6) & kOnes) * 9;
+  uint64_t bytes = ((nibbles & 0x000F000F000F000FULL) << 4) |
+                   ((nibbles >> 8) & 0x000F000F000F000FULL);
+  return ((bytes & 0xFF) << 24) | (bytes & 0xFF0000) |
+         ((bytes >> 24) & 0xFF00) | ((bytes >> 48) & 0xFF);
+}
+
+inline parsing::ParseResult decodeDecimal(char** pos_ptr, char* in_buf_end,
+                                          uint64_t max, uint64_t* value,
+                                          bool complete = false) {
+  char* pos = *pos_ptr;
+  uint64_t v = 0;
+  bool terminated = false;
+
+  // eight digits at a time while there is enough input
+  while (in_buf_end - pos >= 8) {
+    uint64_t chunk = load64(pos);
+    int n = leadingDigits(nonDecimalMask(chunk));
+    if (n > 0) {
+      // shift out trailing non-digits, shifting in leading zeros
+      uint64_t part = decimalChunkValue(chunk << (8 * (8 - n)));
+      if (v > (max - part) / kPowersOf10[n])
+        return parsing::ParseResult::INVALID_INPUT;
+      v = v * kPowersOf10[n] + part;
+      pos += n;
+    }
+    if (n < 8) {
+      terminated = true;
+      break;
+    }
+  }
+
+  // remaining input byte by byte
+  while (!terminated) {
+    if (pos == in_buf_end) {
+      if (!complete) return parsing::ParseResult::OUT_OF_DATA;
+      break;
+    }
+    uint64_t digit = static_cast<unsigned char>(*pos) - '0';
+    if (digit > 9) break;
+    if (v > (max - digit) / 10) return parsing::ParseResult::INVALID_INPUT;
+    v = v * 10 + digit;
+    pos++;
+  }
+
+  if (pos == *pos_ptr) return parsing::ParseResult::INVALID_INPUT;
+  *value = v;
+  *pos_ptr = pos;
+  return parsing::ParseResult::DONE;
+}
+
+inline parsing::ParseResult decodeHex(char** pos_ptr, char* in_buf_end,
+                                      uint64_t max, uint64_t* value,
+                                      bool complete = false) {
+  char* pos = *pos_ptr;
+  uint64_t v = 0;
+  bool terminated = false;
+
+  // eight digits at a time while there is enough input
+  while (in_buf_end - pos >= 8) {
+    uint64_t chunk = load64(pos);
+    int n = leadingDigits(nonHexMask(chunk));
+    if (n > 0) {
+      // shift out trailing non-digits, shifting in leading zeros
+      uint64_t part = hexChunkValue(chunk << (8 * (8 - n)));
+      if (v > ((max - part) >> (4 * n)))
+        return parsing::ParseResult::INVALID_INPUT;
+      v = (v << (4 * n)) | part;
+      pos += n;
+    }
+    if (n < 8) {
+      terminated = true;
+      break;
+    }
+  }
+
+  // remaining input byte by byte
+  while (!terminated) {
+    if (pos == in_buf_end) {
+      if (!complete) return parsing::ParseResult::OUT_OF_DATA;
+      break;
+    }
+    uint64_t c = static_cast<unsigned char>(*pos);
+    uint64_t digit;
+    if (c - '0' <= 9) {
+      digit = c - '0';
+    } else if ((c | 0x20) - 'a' <= 5) {
+      digit = (c | 0x20) - 'a' + 10;
+    } else {
+      break;
+    }
+    if (v > ((max - digit) >> 4)) return parsing::ParseResult::INVALID_INPUT;
+    v = (v << 4) | digit;
+    pos++;
+  }
+
+  if (pos == *pos_ptr) return parsing::ParseResult::INVALID_INPUT;
+  *value = v;
+  *pos_ptr = pos;
+  return parsing::ParseResult::DONE;
+}
+
+// Number of digits of the encoded value.
+inline size_t decimalLength(uint64_t value) {
+  size_t len = 1;
+  for (; value >= 10000; value /= 10000) len += 4;
+  if (value >= 100) {
+    len += 2;
+    value /= 100;
+  }
+  if (value >= 10) len++;
+  return len;
+}
+
+inline size_t hexLength(uint64_t value) {
+  return value ? (64 - __builtin_clzll(value) + 3) / 4 : 1;
+}
+
+inline serializing::SerializeResult encodeDecimal(uint64_t value,
+                                                  char** pos_ptr,
+                                                  char* out_buf_end) {
+  char digits[20];
+  char* end = digits + sizeof(digits);
+  char* start = end;
+
+  // two digits at a time from the back
+  while (value >= 100) {
+    start -= 2;
+    memcpy(start, kDecimalDigitPairs + (value % 100) * 2, 2);
+    value /= 100;
+  }
+  if (value >= 10) {
+    start -= 2;
+    memcpy(start, kDecimalDigitPairs + value * 2, 2);
+  } else {
+    *--start = static_cast<char>('0' + value);
+  }
+
+  size_t len = end - start;
+  if (out_buf_end - *pos_ptr < static_cast<ssize_t>(len))
+    return serializing::SerializeResult::OUT_BUF_FULL;
+  memcpy(*pos_ptr, start, len);
+  *pos_ptr += len;
+  return serializing::SerializeResult::DONE;
+}
+
+inline serializing::SerializeResult encodeHex(uint64_t value, char** pos_ptr,
+                                              char* out_buf_end) {
+  size_t len = hexLength(value);
+  if (out_buf_end - *pos_ptr < static_cast<ssize_t>(len))
+    return serializing::SerializeResult::OUT_BUF_FULL;
+
+  char* pos = *pos_ptr + len;
+  do {
+    *--pos = kHexDigits[value & 0xF];
+    value >>= 4;
+  } while (value);
+  *pos_ptr += len;
+  return serializing::SerializeResult::DONE;
+}
+
+}  // namespace ascii
+
+// A built-in transform between an ASCII-encoded integer (decimal or hex) and
+// an unsigned integer of type T.
+template <typename T, bool Hex>
+struct AsciiInteger {
+  static parsing::ParseResult decode(char** pos_ptr, char* in_buf_end,
+                                     char* parse_dest) {
+    uint64_t value;
+    auto res = Hex ? ascii::decodeHex(pos_ptr, in_buf_end, T(~T(0)), &value)
+                   : ascii::decodeDecimal(pos_ptr, in_buf_end, T(~T(0)),
+                                          &value);
+    if (res == parsing::ParseResult::DONE)
+      *reinterpret_cast<T*>(parse_dest) = static_cast<T>(value);
+    return res;
+  }
+
+  // Decodes a complete value, e.g. a bytes field, that consists of a number
+  // only.
+  template <typename BytesT>
+  static parsing::ParseResult decodeBytes(const BytesT& bytes,
+                                          char* parse_dest) {
+    char* pos = bytes.data_;
+    char* end = pos + bytes.len_;
+    uint64_t value;
+    auto res = Hex ? ascii::decodeHex(&pos, end, T(~T(0)), &value, true)
+                   : ascii::decodeDecimal(&pos, end, T(~T(0)), &value, true);
+    if (res == parsing::ParseResult::DONE && pos != end)
+      return parsing::ParseResult::INVALID_INPUT;
+    if (res == parsing::ParseResult::DONE)
+      *reinterpret_cast<T*>(parse_dest) = static_cast<T>(value);
+    return res;
+  }
+
+  static serializing::SerializeResult encode(char* serialize_src,
+                                             char** pos_ptr,
+                                             char* out_buf_end) {
+    uint64_t value = *reinterpret_cast<T*>(serialize_src);
+    return Hex ? ascii::encodeHex(value, pos_ptr, out_buf_end)
+               : ascii::encodeDecimal(value, pos_ptr, out_buf_end);
+  }
+
+  // Number of bytes encode() writes for the value.
+  static size_t encodedLength(const char* serialize_src) {
+    uint64_t value = *reinterpret_cast<const T*>(serialize_src);
+    return Hex ? ascii::hexLength(value) : ascii::decimalLength(value);
+  }
+};
+
+// names as used in &transform attributes of specs
+typedef AsciiInteger<uint32_t, false> stringEncodedUint32;
+typedef AsciiInteger<uint64_t, false> stringEncodedUint64;
+typedef AsciiInteger<uint32_t, true> hexStringEncodedUint32;
+typedef AsciiInteger<uint64_t, true> hexStringEncodedUint64;
+
+}  // namespace transform
+}  // namespace runtime
+}  // namespace diffingo
+
+#endif  // SRC_RUNTIME_TRANSFORM_ASCII_INTEGER_H_
@@ -0,0 +1,146 @@
+/*
+ * block_allocator.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "runtime/unit/block_allocator.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(__unix__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+namespace diffingo {
+namespace runtime {
+namespace unit {
+
+namespace {
+
+size_t roundUp(size_t size, size_t multiple) {
+  return (size + multiple - 1) / multiple * multiple;
+}
+
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu)
+// Prefers memory of the calling thread's NUMA node for the given range. Uses
+// the raw syscalls to avoid depending on libnuma. Errors (e.g. kernels
+// without NUMA support) are ignored, the memory is then placed as usual.
+void bindToLocalNode(char* block, size_t size) {
+  const int kMpolPreferred = 1;  // MPOL_PREFERRED in <linux/mempolicy.h>
+  const size_t kMaxNodes = 1024;
+  const size_t kBitsPerWord = 8 * sizeof(unsigned long);  // NOLINT
+
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0 || node >= kMaxNodes)
+    return;
+
+  unsigned long nodemask[kMaxNodes / kBitsPerWord] = {};  // NOLINT
+  nodemask[node / kBitsPerWord] = 1UL << (node % kBitsPerWord);
+  syscall(SYS_mbind, block, size, kMpolPreferred, nodemask, kMaxNodes, 0);
+}
+#else
+void bindToLocalNode(char* block, size_t size) {}
+#endif
+
+}  // namespace
+
+char* BlockAllocator::allocate(size_t size) const {
+#if defined(__unix__)
+  size_t mapped = mappedSize(size);
+  bool huge = options_.huge_pages && size >= kHugePageSize;
+  char* block = nullptr;
+
+#if defined(MAP_HUGETLB)
+  // explicit huge pages, only available if the administrator reserved some
+  if (huge) {
+    void* p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) block = static_cast<char*>(p);
+  }
+#endif
+
+  if (!block) {
+    // regular pages. transparent huge pages require the block to be aligned
+    // to the huge page size, so map an extra huge page and trim the ends.
+    size_t extra = huge ? kHugePageSize : 0;
+    void* p = mmap(nullptr, mapped + extra, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return nullptr;
+
+    char* start = static_cast<char*>(p);
+    block = start;
+    if (huge) {
+      block = reinterpret_cast<char*>(
+          roundUp(reinterpret_cast<uintptr_t>(start), kHugePageSize));
+      if (block > start) munmap(start, static_cast<size_t>(block - start));
+      size_t tail =
+          static_cast<size_t>((start + mapped + extra) - (block + mapped));
+      if (tail > 0) munmap(block + mapped, tail);
+#if defined(MADV_HUGEPAGE)
+      madvise(block, mapped, MADV_HUGEPAGE);
+#endif
+    }
+  }
+
+  // the memory policy only applies to pages faulted in afterwards
+  if (options_.numa_local) bindToLocalNode(block, mapped);
+  if (options_.prefault) {
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    for (size_t offset = 0; offset < mapped; offset += page_size)
+      block[offset] = 0;
+  }
+  return block;
+#else
+  return reinterpret_cast<char*>(malloc(size));
+#endif
+}
+
+void BlockAllocator::deallocate(char* block, size_t size) const {
+  if (!block) return;
+#if defined(__unix__)
+  munmap(block, mappedSize(size));
+#else
+  free(block);
+#endif
+}
+
+size_t BlockAllocator::mappedSize(size_t size) const {
+#if defined(__unix__)
+  // small blocks aren't worth a huge page
+  if (options_.huge_pages && size >= kHugePageSize)
+    return roundUp(size, kHugePageSize);
+  return roundUp(size, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+#else
+  return size;
+#endif
+}
+
+}  // namespace unit
+}  // namespace runtime
+}  // namespace diffingo
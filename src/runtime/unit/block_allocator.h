@@ -0,0 +1,77 @@
+/*
+ * block_allocator.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SRC_RUNTIME_UNIT_BLOCK_ALLOCATOR_H_
+#define SRC_RUNTIME_UNIT_BLOCK_ALLOCATOR_H_
+
+#include <stddef.h>
+
+namespace diffingo {
+namespace runtime {
+namespace unit {
+
+/// Allocates large blocks of memory for UnitAreas and ParserState stacks
+/// directly with mmap, backed by huge pages where possible to reduce TLB
+/// misses. Falls back to regular pages on systems without (reserved) huge
+/// pages, and to malloc where mmap isn't available.
+class BlockAllocator {
+ public:
+  struct Options {
+    /// Use explicit huge pages (MAP_HUGETLB) if reserved, and transparent
+    /// huge pages (MADV_HUGEPAGE) otherwise.
+    bool huge_pages = true;
+    /// Prefer memory of the calling thread's NUMA node (ignored on
+    /// single-node systems).
+    bool numa_local = true;
+    /// Touch all pages up front, so that page faults don't occur while
+    /// parsing.
+    bool prefault = false;
+  };
+
+  static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+  BlockAllocator() {}
+  explicit BlockAllocator(const Options& options) : options_(options) {}
+
+  /// Returns a block of at least size bytes, or nullptr.
+  char* allocate(size_t size) const;
+
+  /// Frees a block returned by allocate(size).
+  void deallocate(char* block, size_t size) const;
+
+  const Options& options() const { return options_; }
+
+ private:
+  size_t mappedSize(size_t size) const;
+
+  Options options_;
+};
+
+}  // namespace unit
+}  // namespace runtime
+}  // namespace diffingo
+
+#endif  // SRC_RUNTIME_UNIT_BLOCK_ALLOCATOR_H_
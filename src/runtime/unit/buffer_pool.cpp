@@ -0,0 +1,215 @@
+/*
+ * buffer_pool.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "runtime/unit/buffer_pool.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace diffingo {
+namespace runtime {
+namespace unit {
+
+namespace {
+
+// buffers are padded to cache lines to avoid false sharing between threads
+const size_t kBufferAlignment = 64;
+const size_t kMaxCachedPools = 4;
+const uint32_t kCacheSize = 16;
+
+// live pools by id, so that exiting threads only return cached buffers to
+// pools that weren't destroyed yet. never freed, as threads may exit after
+// static destructors ran.
+struct Registry {
+  std::mutex mutex;
+  std::unordered_map<uint64_t, BufferPool*> pools;
+  uint64_t next_id = 1;
+  // incremented whenever a pool is destroyed
+  std::atomic<uint64_t> generation{0};
+};
+
+Registry& registry() {
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+uint64_t registerPool(BufferPool* pool) {
+  auto& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  uint64_t id = reg.next_id++;
+  reg.pools[id] = pool;
+  return id;
+}
+
+}  // namespace
+
+/// Buffers most recently released by the current thread, per pool. Cached
+/// buffers are returned to their pools when the thread exits, unless the pool
+/// was destroyed in the meantime.
+struct BufferPool::ThreadCache {
+  struct Entry {
+    uint64_t pool_id = 0;
+    uint32_t count = 0;
+    uint32_t indices[kCacheSize];
+  };
+
+  Entry entries[kMaxCachedPools];
+  // registry generation when entries of destroyed pools were last reclaimed
+  uint64_t generation = 0;
+  // set once the thread's cache was destroyed during thread exit
+  static thread_local bool destroyed;
+
+  ~ThreadCache() {
+    auto& reg = registry();
+    {
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      for (auto& e : entries) {
+        if (e.count == 0) continue;
+        auto it = reg.pools.find(e.pool_id);
+        if (it == reg.pools.end()) continue;
+        for (uint32_t i = 0; i < e.count; ++i) it->second->push(e.indices[i]);
+      }
+    }
+    destroyed = true;
+  }
+
+  // returns the current thread's entry for the pool, or nullptr if the cache
+  // is bypassed (too many pools or during thread exit)
+  static Entry* entry(BufferPool* pool) {
+    static thread_local ThreadCache cache;
+    if (destroyed) return nullptr;
+
+    Entry* free = nullptr;
+    for (auto& e : cache.entries) {
+      if (e.pool_id == pool->id_) return &e;
+      if (!e.pool_id && !free) free = &e;
+    }
+    if (!free) free = cache.reclaim();
+    if (free) {
+      free->pool_id = pool->id_;
+      free->count = 0;
+    }
+    return free;
+  }
+
+  // frees the first entry of a destroyed pool. only takes the registry lock
+  // if pools were destroyed since the last call.
+  Entry* reclaim() {
+    auto& reg = registry();
+    uint64_t current = reg.generation.load(std::memory_order_acquire);
+    if (current == generation) return nullptr;
+
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (auto& e : entries) {
+      if (!reg.pools.count(e.pool_id)) {
+        e.pool_id = 0;
+        e.count = 0;
+        return &e;
+      }
+    }
+    // all entries belong to live pools, don't check again until another
+    // pool was destroyed
+    generation = current;
+    return nullptr;
+  }
+};
+
+thread_local bool BufferPool::ThreadCache::destroyed = false;
+
+BufferPool::BufferPool(size_t buffer_size, uint32_t capacity,
+                       const BlockAllocator::Options& options)
+    : id_(registerPool(this)),
+      buffer_size_((buffer_size + kBufferAlignment - 1) / kBufferAlignment *
+                   kBufferAlignment),
+      capacity_(capacity),
+      allocator_(options),
+      slab_(allocator_.allocate(buffer_size_ * capacity)),
+      head_(kNone),
+      next_(new std::atomic<uint32_t>[capacity]),
+      used_(slab_ ? 0 : capacity) {}
+
+BufferPool::~BufferPool() {
+  // after unregistering, exiting threads no longer return their cached
+  // buffers, and entries of the pool can be reclaimed
+  auto& reg = registry();
+  {
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.pools.erase(id_);
+  }
+  reg.generation.fetch_add(1, std::memory_order_release);
+  allocator_.deallocate(slab_, buffer_size_ * capacity_);
+}
+
+char* BufferPool::acquire() {
+  auto entry = ThreadCache::entry(this);
+  if (entry && entry->count > 0) return buffer(entry->indices[--entry->count]);
+
+  uint32_t index = pop();
+  return index == kNone ? nullptr : buffer(index);
+}
+
+void BufferPool::release(char* buffer) {
+  auto entry = ThreadCache::entry(this);
+  if (entry && entry->count < kCacheSize) {
+    entry->indices[entry->count++] = index(buffer);
+    return;
+  }
+  push(index(buffer));
+}
+
+uint32_t BufferPool::pop() {
+  uint64_t head = head_.load(std::memory_order_acquire);
+  for (;;) {
+    uint32_t index = static_cast<uint32_t>(head);
+    if (index == kNone) break;
+    uint64_t next = ((head >> 32) + 1) << 32 |
+                    next_[index].load(std::memory_order_relaxed);
+    if (head_.compare_exchange_weak(head, next, std::memory_order_acquire))
+      return index;
+  }
+
+  // free list is empty, hand out a buffer that wasn't used yet
+  uint32_t used = used_.load(std::memory_order_relaxed);
+  while (used < capacity_) {
+    if (used_.compare_exchange_weak(used, used + 1, std::memory_order_relaxed))
+      return used;
+  }
+  return kNone;
+}
+
+void BufferPool::push(uint32_t index) {
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  uint64_t next;
+  do {
+    next_[index].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+    next = ((head >> 32) + 1) << 32 | index;
+  } while (!head_.compare_exchange_weak(head, next, std::memory_order_release,
+                                        std::memory_order_relaxed));
+}
+
+}  // namespace unit
+}  // namespace runtime
+}  // namespace diffingo
@@ -0,0 +1,107 @@
+/*
+ * buffer_pool.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SRC_RUNTIME_UNIT_BUFFER_POOL_H_
+#define SRC_RUNTIME_UNIT_BUFFER_POOL_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "runtime/unit/block_allocator.h"
+
+namespace diffingo {
+namespace runtime {
+namespace unit {
+
+/// Pool of equally sized buffers, e.g. for the UnitAreas or ParserState
+/// stacks of connections. Connections only hold buffers while they parse, so
+/// that memory scales with the number of active parses rather than open
+/// connections.
+///
+/// Buffers are carved from a single slab reserved up front by a
+/// BlockAllocator (its pages are only touched once buffers are used, unless
+/// the allocator prefaults them). Released buffers are cached per
+/// thread and otherwise kept on a lock-free global free list.
+///
+/// Other threads mustn't use a pool while it is destroyed. Buffers they still
+/// cache for it are dropped then, as the caches refer to pools by a unique
+/// id rather than their address.
+class BufferPool {
+ public:
+  BufferPool(
+      size_t buffer_size, uint32_t capacity,
+      const BlockAllocator::Options& options = BlockAllocator::Options());
+  ~BufferPool();
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  /// Returns a buffer, or nullptr if all buffers are in use.
+  char* acquire();
+
+  /// Returns a buffer acquired from this pool (by any thread).
+  void release(char* buffer);
+
+  size_t buffer_size() const { return buffer_size_; }
+  uint32_t capacity() const { return capacity_; }
+
+ private:
+  struct ThreadCache;
+  friend struct ThreadCache;
+
+  static const uint32_t kNone = UINT32_MAX;
+
+  char* buffer(uint32_t index) const { return slab_ + index * buffer_size_; }
+  uint32_t index(char* buffer) const {
+    return static_cast<uint32_t>(static_cast<size_t>(buffer - slab_) /
+                                 buffer_size_);
+  }
+
+  uint32_t pop();
+  void push(uint32_t index);
+
+  // unique among all pools of the process, never 0
+  const uint64_t id_;
+  const size_t buffer_size_;
+  const uint32_t capacity_;
+  const BlockAllocator allocator_;
+  char* slab_;
+
+  // free list of buffer indices, linked via next_. the head holds the index
+  // in its lower and an ABA counter in its upper 32 bits.
+  std::atomic<uint64_t> head_;
+  std::unique_ptr<std::atomic<uint32_t>[]> next_;
+  // number of buffers handed out from the slab so far
+  std::atomic<uint32_t> used_;
+};
+
+}  // namespace unit
+}  // namespace runtime
+}  // namespace diffingo
+
+#endif  // SRC_RUNTIME_UNIT_BUFFER_POOL_H_
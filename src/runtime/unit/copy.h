@@ -0,0 +1,184 @@
+/*
+ * copy.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SRC_RUNTIME_UNIT_COPY_H_
+#define SRC_RUNTIME_UNIT_COPY_H_
+
+#include <stddef.h>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace diffingo {
+namespace runtime {
+namespace unit {
+
+/// Size (in bytes) from which copyMemory() bypasses the caches. Copying
+/// large values through the caches would evict hot data, such as the units'
+/// fixed fields and parser constants. The crossover depends on the machine
+/// (see perfeval/copy_evaluator.cpp).
+inline size_t& nonTemporalCopyThreshold() {
+  static size_t threshold = 8 * 1024 * 1024;
+  return threshold;
+}
+
+namespace detail {
+
+// Values up to this size are copied inline, larger ones with memcpy, which
+// picks the best vector instructions of the machine at runtime.
+const size_t kInlineCopyMax = 64;
+const size_t kPrefetchDistance = 512;
+
+// Copies up to 16 bytes with two (possibly overlapping) loads and stores.
+inline void copySmall(char* dest, const char* src, size_t len) {
+  if (len >= 8) {
+    uint64_t head, tail;
+    memcpy(&head, src, 8);
+    memcpy(&tail, src + len - 8, 8);
+    memcpy(dest, &head, 8);
+    memcpy(dest + len - 8, &tail, 8);
+  } else if (len >= 4) {
+    uint32_t head, tail;
+    memcpy(&head, src, 4);
+    memcpy(&tail, src + len - 4, 4);
+    memcpy(dest, &head, 4);
+    memcpy(dest + len - 4, &tail, 4);
+  } else if (len > 0) {
+    dest[0] = src[0];
+    dest[len / 2] = src[len / 2];
+    dest[len - 1] = src[len - 1];
+  }
+}
+
+#if defined(__AVX__)
+typedef __m256i Vector;
+inline Vector loadVector(const char* p) {
+  return _mm256_loadu_si256(reinterpret_cast<const Vector*>(p));
+}
+inline void storeVector(char* p, Vector v) {
+  _mm256_storeu_si256(reinterpret_cast<Vector*>(p), v);
+}
+#elif defined(__SSE2__)
+typedef __m128i Vector;
+inline Vector loadVector(const char* p) {
+  return _mm_loadu_si128(reinterpret_cast<const Vector*>(p));
+}
+inline void storeVector(char* p, Vector v) {
+  _mm_storeu_si128(reinterpret_cast<Vector*>(p), v);
+}
+#endif
+
+// Copies more than 16 bytes with vector (AVX, if enabled at compile time, or
+// SSE2) loads and stores. The last vector may overlap the previous one.
+inline void copyVector(char* dest, const char* src, size_t len) {
+#if defined(__SSE2__)
+  const size_t kSize = sizeof(Vector);
+  if (len < kSize) {
+    // only with 32 byte vectors: 16 < len < 32
+    copySmall(dest, src, 16);
+    copySmall(dest + len - 16, src + len - 16, 16);
+    return;
+  }
+
+  size_t i = 0;
+  for (; i + 2 * kSize <= len; i += 2 * kSize) {
+    Vector a = loadVector(src + i);
+    Vector b = loadVector(src + i + kSize);
+    storeVector(dest + i, a);
+    storeVector(dest + i + kSize, b);
+  }
+  if (i + kSize < len) storeVector(dest + i, loadVector(src + i));
+  storeVector(dest + len - kSize, loadVector(src + len - kSize));
+#else
+  memcpy(dest, src, len);
+#endif
+}
+
+// Copies at least 16 bytes with non-temporal stores that bypass the caches,
+// prefetching the source ahead of the loads.
+inline void copyNonTemporal(char* dest, const char* src, size_t len) {
+#if defined(__SSE2__)
+  // streaming stores need an aligned destination
+  size_t head = (16 - reinterpret_cast<uintptr_t>(dest) % 16) % 16;
+  copySmall(dest, src, head);
+  dest += head;
+  src += head;
+  len -= head;
+
+  for (; len >= 64; len -= 64, dest += 64, src += 64) {
+    _mm_prefetch(src + kPrefetchDistance, _MM_HINT_NTA);
+    const __m128i* s = reinterpret_cast<const __m128i*>(src);
+    __m128i* d = reinterpret_cast<__m128i*>(dest);
+    __m128i a = _mm_loadu_si128(s);
+    __m128i b = _mm_loadu_si128(s + 1);
+    __m128i c = _mm_loadu_si128(s + 2);
+    __m128i e = _mm_loadu_si128(s + 3);
+    _mm_stream_si128(d, a);
+    _mm_stream_si128(d + 1, b);
+    _mm_stream_si128(d + 2, c);
+    _mm_stream_si128(d + 3, e);
+  }
+  // order the streaming stores before subsequent (regular) stores
+  _mm_sfence();
+
+  if (len > 16)
+    copyVector(dest, src, len);
+  else
+    copySmall(dest, src, len);
+#else
+  memcpy(dest, src, len);
+#endif
+}
+
+}  // namespace detail
+
+/// Copies len bytes from src to dest (which must not overlap), with a
+/// strategy depending on the size: small values are copied inline with a few
+/// word or vector moves, medium ones with memcpy, and values of at least
+/// nonTemporalCopyThreshold() bytes with streaming stores that don't pollute
+/// the caches.
+inline void copyMemory(char* dest, const char* src, size_t len) {
+  if (len <= 16)
+    detail::copySmall(dest, src, len);
+  else if (len <= detail::kInlineCopyMax)
+    detail::copyVector(dest, src, len);
+  else if (len < nonTemporalCopyThreshold())
+    memcpy(dest, src, len);
+  else
+    detail::copyNonTemporal(dest, src, len);
+}
+
+}  // namespace unit
+}  // namespace runtime
+}  // namespace diffingo
+
+#endif  // SRC_RUNTIME_UNIT_COPY_H_
@@ -27,6 +27,10 @@
 #ifndef SRC_RUNTIME_UNIT_DATA_TYPE_H_
 #define SRC_RUNTIME_UNIT_DATA_TYPE_H_
 
+#include <stddef.h>
+#include <sys/types.h>
+#include <cstdint>
+
 namespace diffingo {
 namespace runtime {
 namespace unit {
@@ -51,6 +55,74 @@ struct var_bytes {
 
 struct var_string : public var_bytes {};
 
+/// Pointer stored as a 32-bit offset relative to its own address. Units
+/// generated in relative offsets mode only use these to refer to data within
+/// their unit area, so the whole area can be copied with a single memcpy (e.g.
+/// into a cache, an mmap'd file or shared memory) and stays valid there.
+template <typename T>
+struct rel_ptr {
+  int32_t off_;
+
+  T* get() const {
+    return reinterpret_cast<T*>(
+        const_cast<char*>(reinterpret_cast<const char*>(this)) + off_);
+  }
+
+  operator T*() const { return get(); }  // NOLINT(runtime/explicit)
+
+  rel_ptr& operator=(T* ptr) {
+    off_ = static_cast<int32_t>(reinterpret_cast<char*>(ptr) -
+                                reinterpret_cast<char*>(this));
+    return *this;
+  }
+};
+
+/// Relocatable variant of var_bytes, half its size.
+struct rel_bytes {
+  uint32_t len_;
+  rel_ptr<char> data_;
+};
+
+struct rel_string : public rel_bytes {};
+
+/// Variable-length bytes that are stored inline in the unit if they fit into
+/// Capacity bytes, and allocated from the unit area otherwise. In both cases
+/// data_ points to the contents, so they can be accessed as BaseT.
+/// With var_bytes as BaseT, the struct must not be copied.
+template <size_t Capacity, typename BaseT = var_bytes>
+struct inline_bytes : public BaseT {
+  static const size_t kCapacity = Capacity;
+
+  char inline_[Capacity];
+};
+
+template <size_t Capacity, typename BaseT = var_string>
+struct inline_string : public BaseT {
+  static const size_t kCapacity = Capacity;
+
+  char inline_[Capacity];
+};
+
+/// Bytes of a length known at compile time, stored inline in the unit.
+template <size_t Len>
+struct fixed_bytes {
+  static const size_t kLen = Len;
+
+  char data_[Len];
+};
+
+/// Bytes in a file or memfd (&file fields), which serializers send with
+/// sendfile() or splice() instead of copying them into the output. len_ comes
+/// first, so length updates can access it like var_bytes. Parsed values are
+/// received into data_ and have an fd_ of -1, serializers copy them like
+/// var_bytes.
+struct file_range {
+  size_t len_;
+  int fd_;
+  off_t offset_;
+  char* data_;
+};
+
 template <typename ItemT>
 struct list {
   typedef ItemT* pointer_array[];
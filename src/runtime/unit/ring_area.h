@@ -0,0 +1,165 @@
+/*
+ * ring_area.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SRC_RUNTIME_UNIT_RING_AREA_H_
+#define SRC_RUNTIME_UNIT_RING_AREA_H_
+
+#include <stddef.h>
+#include <cassert>
+#include <cstdint>
+#include <new>
+
+#include "runtime/unit/unit_area.h"
+
+namespace diffingo {
+namespace runtime {
+namespace unit {
+
+/// Fixed-size arena for the units of a pipelined connection. Each message is
+/// parsed into a UnitArea placed at the ring's head (see begin()), which is
+/// kept by commit(). Units are released again in FIFO order, oldest first,
+/// so that the arena can be reused indefinitely without resetting it as a
+/// whole. Committed units are identified by increasing generation numbers.
+///
+/// The buffer should be aligned to kAlignment.
+class RingArea {
+ public:
+  static const size_t kAlignment = 8;
+
+  RingArea(char *buffer, size_t size)
+      : buffer_(buffer), size_(size / kAlignment * kAlignment) {
+    clear();
+  }
+
+  /// Returns an empty area covering the largest contiguous free space, or
+  /// nullptr if it has less than min_size bytes. The area is only kept if it
+  /// is committed before begin() is called again.
+  UnitArea *begin(size_t min_size = 0) {
+    size_t offset = head_;
+    size_t space;
+    if (wrapped_) {
+      space = tail_ - head_;
+    } else {
+      space = size_ - head_;
+      if (count_ > 0 && tail_ > space) {
+        // more space at the start of the buffer, wrap around
+        offset = 0;
+        space = tail_;
+      }
+    }
+    if (space < sizeof(UnitArea) + min_size) return nullptr;
+
+    pending_ = offset;
+    return new (buffer_ + offset) UnitArea(space);
+  }
+
+  /// Keeps the area returned by the last begin() call, shrunk to its
+  /// allocations, which must not grow afterwards. Returns its generation.
+  uint64_t commit(UnitArea *area) {
+    assert(reinterpret_cast<char *>(area) == buffer_ + pending_);
+    area->shrinkToFit();
+    if (pending_ != head_) {
+      // wrapped around, data before the old head ends at wrap_end_
+      wrap_end_ = head_;
+      wrapped_ = true;
+    }
+    head_ = pending_ + chunkSize(area);
+    ++count_;
+    return next_generation_++;
+  }
+
+  /// Releases the oldest committed unit.
+  void releaseOldest() {
+    assert(count_ > 0);
+    tail_ += chunkSize(reinterpret_cast<UnitArea *>(buffer_ + tail_));
+    ++oldest_generation_;
+    if (--count_ == 0) {
+      // start over at the beginning to maximize contiguous space
+      head_ = tail_ = 0;
+      wrapped_ = false;
+    } else if (wrapped_ && tail_ == wrap_end_) {
+      tail_ = 0;
+      wrapped_ = false;
+    }
+  }
+
+  /// Releases all units up to (and including) the given generation.
+  void releaseUntil(uint64_t generation) {
+    while (count_ > 0 && oldest_generation_ <= generation) releaseOldest();
+  }
+
+  /// Releases all units.
+  void clear() {
+    head_ = tail_ = wrap_end_ = pending_ = 0;
+    wrapped_ = false;
+    count_ = 0;
+    oldest_generation_ = next_generation_;
+  }
+
+  /// Returns the area of the unit with given generation, which must be live.
+  UnitArea *area(uint64_t generation) const {
+    assert(live(generation));
+    size_t offset = tail_;
+    for (uint64_t g = oldest_generation_; g < generation; ++g) {
+      offset += chunkSize(reinterpret_cast<UnitArea *>(buffer_ + offset));
+      if (wrapped_ && offset == wrap_end_) offset = 0;
+    }
+    return reinterpret_cast<UnitArea *>(buffer_ + offset);
+  }
+
+  /// Returns true if the unit with given generation hasn't been released.
+  bool live(uint64_t generation) const {
+    return generation >= oldest_generation_ && generation < next_generation_;
+  }
+
+  size_t count() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  uint64_t oldest_generation() const { return oldest_generation_; }
+  uint64_t next_generation() const { return next_generation_; }
+
+ private:
+  static size_t chunkSize(UnitArea *area) {
+    size_t size = sizeof(UnitArea) + area->size();
+    return (size + kAlignment - 1) / kAlignment * kAlignment;
+  }
+
+  char *buffer_;
+  size_t size_;
+  size_t head_;      // offset after the newest unit
+  size_t tail_;      // offset of the oldest unit
+  size_t wrap_end_;  // offset after the last unit before wrapping around
+  size_t pending_;   // offset of the area returned by begin()
+  bool wrapped_;     // head_ wrapped around, i.e. is before tail_
+  size_t count_;
+  uint64_t oldest_generation_;
+  uint64_t next_generation_ = 0;
+};
+
+}  // namespace unit
+}  // namespace runtime
+}  // namespace diffingo
+
+#endif  // SRC_RUNTIME_UNIT_RING_AREA_H_
@@ -80,6 +80,9 @@ class UnitArea {
     nextAllocPos_ = contents();
   }
 
+  /// Limits the area to its current allocations.
+  void shrinkToFit() { size_ = allocated(); }
+
  private:
   char *nextAllocPos_;
   size_t size_;
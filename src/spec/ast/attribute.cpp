@@ -56,7 +56,8 @@ bool Attribute::operator==(const Attribute& other) const {
 }
 
 node_ptr<Attribute> Attribute::clone() const {
-  return ast::newNodePtr(std::make_shared<Attribute>(key(), value()->clone(),
+  auto value_clone = value() ? value()->clone() : nullptr;
+  return ast::newNodePtr(std::make_shared<Attribute>(key(), value_clone,
                                                      internal(), location()));
 }
 
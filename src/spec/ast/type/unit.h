@@ -319,6 +319,9 @@ class Field : public Item {
       const Location& l = Location::None);
 
   node_ptr<expression::Expression> condition() { return condition_; }
+  void set_condition(node_ptr<expression::Expression> cond) {
+    condition_ = cond;
+  }
 
   expression_list parameters() const { return parameters_; }
 
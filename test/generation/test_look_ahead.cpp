@@ -0,0 +1,216 @@
+/*
+ * test_look_ahead.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "generation/parsing/look_ahead.h"
+
+namespace la = diffingo::generation::parsing::look_ahead;
+
+namespace {
+
+la::ByteSet bytes(const std::string& chars) {
+  la::ByteSet set;
+  for (char c : chars) set.set(static_cast<unsigned char>(c));
+  return set;
+}
+
+la::ByteSet range(char from, char to) {
+  la::ByteSet set;
+  for (int c = from; c <= to; c++) set.set(static_cast<size_t>(c));
+  return set;
+}
+
+la::Prefix regExp(const std::string& pattern) {
+  return la::regExpPrefix({pattern});
+}
+
+size_t entry(const std::string& table, size_t index) {
+  return static_cast<uint8_t>(table[index]);
+}
+
+}  // namespace
+
+TEST(LookAheadTest, BytesPrefix) {
+  auto prefix = la::bytesPrefix("GET");
+  ASSERT_EQ(bytes("G"), prefix[0]);
+  ASSERT_EQ(bytes("E"), prefix[1]);
+
+  // positions after the constant can be anything
+  prefix = la::bytesPrefix("G");
+  ASSERT_EQ(bytes("G"), prefix[0]);
+  ASSERT_TRUE(prefix[1].all());
+}
+
+TEST(LookAheadTest, RegExpPrefixLiteralsAndClasses) {
+  auto prefix = regExp("GET /");
+  ASSERT_EQ(bytes("G"), prefix[0]);
+  ASSERT_EQ(bytes("E"), prefix[1]);
+
+  prefix = regExp("[0-9][a-cx]");
+  ASSERT_EQ(range('0', '9'), prefix[0]);
+  ASSERT_EQ(bytes("abcx"), prefix[1]);
+
+  prefix = regExp("\\d\\s");
+  ASSERT_EQ(range('0', '9'), prefix[0]);
+  ASSERT_EQ(bytes(" \t\n\v\f\r"), prefix[1]);
+
+  // escaped specials are literals, a trailing '-' in a class isn't a range
+  prefix = regExp("\\.[a-]");
+  ASSERT_EQ(bytes("."), prefix[0]);
+  ASSERT_EQ(bytes("a-"), prefix[1]);
+
+  prefix = regExp("[^\\r\\n].");
+  ASSERT_EQ(~bytes("\r\n"), prefix[0]);
+  ASSERT_EQ(~bytes("\n"), prefix[1]);
+}
+
+TEST(LookAheadTest, RegExpPrefixQuantifiers) {
+  // the position after a repeated atom is a repetition or the next atom
+  auto prefix = regExp("[0-9]+ ");
+  ASSERT_EQ(range('0', '9'), prefix[0]);
+  ASSERT_EQ(range('0', '9') | bytes(" "), prefix[1]);
+
+  prefix = regExp("a+");
+  ASSERT_EQ(bytes("a"), prefix[0]);
+  ASSERT_TRUE(prefix[1].all());
+
+  // optional atoms make the position depend on the following ones
+  prefix = regExp("ab?c");
+  ASSERT_EQ(bytes("a"), prefix[0]);
+  ASSERT_TRUE(prefix[1].all());
+
+  prefix = regExp("a*b");
+  ASSERT_TRUE(prefix[0].all());
+  ASSERT_TRUE(prefix[1].all());
+}
+
+TEST(LookAheadTest, RegExpPrefixUnsupported) {
+  // groups, alternatives and malformed classes match any input
+  for (auto pattern : {"(GET|PUT)", "|a", "[ab", "[b-a]", "^GET"}) {
+    auto prefix = regExp(pattern);
+    ASSERT_TRUE(prefix[0].all()) << pattern;
+    ASSERT_TRUE(prefix[1].all()) << pattern;
+  }
+
+  // an unsupported construct only affects the positions from there on
+  auto prefix = regExp("G(ET)");
+  ASSERT_EQ(bytes("G"), prefix[0]);
+  ASSERT_TRUE(prefix[1].all());
+}
+
+TEST(LookAheadTest, RegExpPrefixOfAlternatives) {
+  auto prefix = la::regExpPrefix({"GET", "PUT", "POST"});
+  ASSERT_EQ(bytes("GP"), prefix[0]);
+  ASSERT_EQ(bytes("EUO"), prefix[1]);
+}
+
+TEST(LookAheadTest, BuildTableFirstByte) {
+  auto table = la::buildTable({la::bytesPrefix("GET"), la::bytesPrefix("PUT"),
+                               regExp("[0-9]+")});
+  ASSERT_EQ(256u, table.first.size());
+  ASSERT_TRUE(table.second.empty());
+  ASSERT_TRUE(table.ambiguous.empty());
+  for (size_t b = 0; b < 256; b++) {
+    size_t expected = 0;
+    if (b == 'G') expected = 1;
+    if (b == 'P') expected = 2;
+    if (b >= '0' && b <= '9') expected = 3;
+    ASSERT_EQ(expected, entry(table.first, b)) << b;
+  }
+}
+
+TEST(LookAheadTest, BuildTableSecondByte) {
+  auto table = la::buildTable({la::bytesPrefix("GE"), la::bytesPrefix("GO"),
+                               la::bytesPrefix("PU")});
+  ASSERT_TRUE(table.ambiguous.empty());
+  ASSERT_EQ(3u, entry(table.first, 'P'));
+
+  // 'G' needs the second byte, which is looked up in the first second level
+  // table
+  ASSERT_EQ(la::Table::kSecondLevel | 0u, entry(table.first, 'G'));
+  ASSERT_EQ(256u, table.second.size());
+  for (size_t b2 = 0; b2 < 256; b2++) {
+    size_t expected = b2 == 'E' ? 1 : b2 == 'O' ? 2 : 0;
+    ASSERT_EQ(expected, entry(table.second, b2)) << b2;
+  }
+}
+
+TEST(LookAheadTest, BuildTableSharesSecondLevelTables) {
+  auto table = la::buildTable({regExp("[AB]X"), regExp("[AB]Y"),
+                               regExp("CX"), regExp("C[XY]")});
+  // A and B share their second level table, C's differs
+  ASSERT_EQ(la::Table::kSecondLevel | 0u, entry(table.first, 'A'));
+  ASSERT_EQ(la::Table::kSecondLevel | 0u, entry(table.first, 'B'));
+  ASSERT_EQ(la::Table::kSecondLevel | 1u, entry(table.first, 'C'));
+  ASSERT_EQ(2 * 256u, table.second.size());
+  ASSERT_EQ(1u, entry(table.second, 'X'));
+  ASSERT_EQ(2u, entry(table.second, 'Y'));
+  ASSERT_EQ(3u, entry(table.second, 256 + 'X'));
+  ASSERT_EQ(4u, entry(table.second, 256 + 'Y'));
+
+  // X after C matches both cases 3 and 4, the earlier one wins
+  ASSERT_EQ(std::vector<size_t>{4}, table.ambiguous);
+}
+
+TEST(LookAheadTest, BuildTableAmbiguousCases) {
+  // a case that matches any input is ambiguous with all earlier ones
+  auto table = la::buildTable({la::bytesPrefix("A"), la::anyPrefix()});
+  ASSERT_EQ(std::vector<size_t>{2}, table.ambiguous);
+  ASSERT_EQ(la::Table::kSecondLevel | 0u, entry(table.first, 'A'));
+  for (size_t b2 = 0; b2 < 256; b2++)
+    ASSERT_EQ(1u, entry(table.second, b2)) << b2;
+  ASSERT_EQ(2u, entry(table.first, 'B'));
+}
+
+TEST(LookAheadTest, BuildTableRunsOutOfSecondLevelTables) {
+  // case k matches first bytes with bit k set and k as second byte, so every
+  // first byte with more than one bit set needs its own second level table.
+  std::vector<la::Prefix> cases;
+  for (size_t k = 0; k < 8; k++) {
+    la::Prefix prefix;
+    for (size_t b = 0; b < 256; b++) {
+      if (b & (1u << k)) prefix[0].set(b);
+    }
+    prefix[1].set(k);
+    cases.push_back(prefix);
+  }
+
+  auto table = la::buildTable(cases);
+  ASSERT_EQ(la::Table::kSecondLevel * 256u, table.second.size());
+  size_t second_level = 0;
+  for (size_t b = 0; b < 256; b++) {
+    if (entry(table.first, b) & la::Table::kSecondLevel) second_level++;
+  }
+  ASSERT_EQ(size_t{la::Table::kSecondLevel}, second_level);
+
+  // once out of tables, the first candidate is chosen
+  ASSERT_EQ(1u, entry(table.first, 0xff));
+  ASSERT_EQ(7u, table.ambiguous.size());
+}
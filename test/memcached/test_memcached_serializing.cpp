@@ -0,0 +1,437 @@
+/*
+ * test_memcached_serializing.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <string>
+#include <vector>
+
+#include "examples/out_test/memcached.h"
+#include "runtime/parsing/parse_result.h"
+#include "runtime/parsing/parser_state.h"
+#include "runtime/serializing/gather_list.h"
+#include "runtime/serializing/serialize_result.h"
+#include "runtime/serializing/wire_template.h"
+#include "runtime/unit/unit_area.h"
+
+namespace dr = diffingo::runtime;
+
+namespace {
+
+// GET request for key "Hello"
+const char kGetRequest[] = {
+    '\x80', 0x00,   0x00,   0x05,   0x00,   0x00,   0x00,   0x00,
+    0x00,   0x00,   0x00,   0x05,   0x00,   0x00,   0x00,   0x00,
+    0x00,   0x00,   0x00,   0x00,   0x00,   0x00,   0x00,   0x00,
+    'H',    'e',    'l',    'l',    'o'};
+
+// GET response with flags 0xdeadbeef and value "World"
+const char kGetResponse[] = {
+    '\x81', 0x00,   0x00,   0x00,   0x04,   0x00,   0x00,   0x00,
+    0x00,   0x00,   0x00,   0x09,   0x00,   0x00,   0x00,   0x00,
+    0x00,   0x00,   0x00,   0x00,   0x00,   0x00,   0x00,   0x01,
+    '\xde', '\xad', '\xbe', '\xef', 'W',    'o',    'r',    'l',
+    'd'};
+
+// SET request for key "Hello" with flags 0xdeadbeef, expiry 3600 and value
+// "World"
+const char kSetRequest[] = {
+    '\x80', 0x01,   0x00,   0x05,   0x08,   0x00,   0x00,   0x00,
+    0x00,   0x00,   0x00,   0x12,   0x00,   0x00,   0x00,   0x00,
+    0x00,   0x00,   0x00,   0x00,   0x00,   0x00,   0x00,   0x00,
+    '\xde', '\xad', '\xbe', '\xef', 0x00,   0x00,   0x0e,   0x10,
+    'H',    'e',    'l',    'l',    'o',    'W',    'o',    'r',
+    'l',    'd'};
+
+const char kZeros[8] = {0};
+const char kCas1[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+class MemcachedSerializingTest : public ::testing::Test {
+ protected:
+  static const size_t kBufSize = 64 * 1024;
+
+  MemcachedSerializingTest()
+      : stack_buf_(kBufSize),
+        area_buf_(kBufSize),
+        out_buf_(kBufSize),
+        state_(stack_buf_.data(), kBufSize) {
+    area_ = new (area_buf_.data()) dr::unit::UnitArea(kBufSize);
+  }
+
+  // Parses a copy of msg into the unit area. The copy stays valid for the
+  // lifetime of the test, as units reference their input.
+  memcached::MemcachedCommand* parse(const char* msg, size_t len) {
+    inputs_.emplace_back(msg, msg + len);
+    auto& in = inputs_.back();
+    char* unit = area_->nextPos();
+    size_t bytes_read;
+    state_.reset();
+    auto res = parser_.parse(in.data(), in.data() + in.size(), area_, &state_,
+                             &bytes_read);
+    EXPECT_EQ(dr::parsing::ParseResult::DONE, res);
+    EXPECT_EQ(len, bytes_read);
+    return reinterpret_cast<memcached::MemcachedCommand*>(unit);
+  }
+
+  char* input(size_t index) { return inputs_[index].data(); }
+
+  static std::string gathered(const dr::serializing::GatherList& gather) {
+    std::string msg;
+    for (size_t i = 0; i < gather.count(); i++) {
+      msg.append(static_cast<const char*>(gather.iov()[i].iov_base),
+                 gather.iov()[i].iov_len);
+    }
+    return msg;
+  }
+
+  std::vector<char> stack_buf_;
+  std::vector<char> area_buf_;
+  std::vector<char> out_buf_;
+  std::vector<std::vector<char>> inputs_;
+  dr::unit::UnitArea* area_;
+  dr::parsing::ParserState state_;
+  memcached::MemcachedCommandParser parser_;
+  memcached::MemcachedCommandSerializer serializer_;
+};
+
+}  // namespace
+
+TEST_F(MemcachedSerializingTest, PatchParsedCase) {
+  auto command = parse(kGetRequest, sizeof(kGetRequest));
+  auto res = memcached::MemcachedCommandSerializer::patch_vbucket_id(
+      input(0), command, 0x1234);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+  ASSERT_EQ(0x1234, command->vbucket_id);
+  ASSERT_EQ('\x12', input(0)[6]);
+  ASSERT_EQ('\x34', input(0)[7]);
+}
+
+TEST_F(MemcachedSerializingTest, PatchUnparsedCaseIsRefused) {
+  auto command = parse(kGetRequest, sizeof(kGetRequest));
+  auto res = memcached::MemcachedCommandSerializer::patch_status(
+      input(0), command, memcached::MemcachedResponseStatus::BUSY);
+  ASSERT_EQ(dr::serializing::SerializeResult::INVALID_UNIT, res);
+  ASSERT_EQ(0, memcmp(kGetRequest, input(0), sizeof(kGetRequest)));
+
+  auto response = parse(kGetResponse, sizeof(kGetResponse));
+  res = memcached::MemcachedCommandSerializer::patch_vbucket_id(input(1),
+                                                                response, 7);
+  ASSERT_EQ(dr::serializing::SerializeResult::INVALID_UNIT, res);
+  ASSERT_EQ(0, memcmp(kGetResponse, input(1), sizeof(kGetResponse)));
+}
+
+TEST_F(MemcachedSerializingTest, PatchOpaque) {
+  auto command = parse(kGetRequest, sizeof(kGetRequest));
+  auto res = memcached::MemcachedCommandSerializer::patch_opaque(
+      input(0), command, "\x01\x02\x03\x04");
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+  ASSERT_EQ(0, memcmp("\x01\x02\x03\x04", input(0) + 12, 4));
+  ASSERT_EQ(0, memcmp("\x01\x02\x03\x04", &command->opaque, 4));
+}
+
+TEST_F(MemcachedSerializingTest, ForwardRewritesOpaque) {
+  auto command = parse(kGetRequest, sizeof(kGetRequest));
+  memcpy(command->opaque.data_, "\x01\x02\x03\x04", 4);
+
+  struct iovec iov[4];
+  char scratch[16];
+  dr::serializing::GatherList gather(iov, 4, scratch, sizeof(scratch));
+  auto res = serializer_.forward(
+      input(0), sizeof(kGetRequest), reinterpret_cast<char*>(command),
+      memcached::MemcachedCommandSerializer::PatchFields::opaque, &gather);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+
+  // the message isn't copied, only opaque is written to the scratch buffer
+  ASSERT_EQ(3u, gather.count());
+  ASSERT_EQ(input(0), gather.iov()[0].iov_base);
+  ASSERT_EQ(12u, gather.iov()[0].iov_len);
+  ASSERT_EQ(scratch, gather.iov()[1].iov_base);
+  ASSERT_EQ(4u, gather.iov()[1].iov_len);
+  ASSERT_EQ(input(0) + 16, gather.iov()[2].iov_base);
+  ASSERT_EQ(sizeof(kGetRequest) - 16, gather.iov()[2].iov_len);
+  ASSERT_EQ(sizeof(kGetRequest), gather.length());
+
+  std::string expected(kGetRequest, sizeof(kGetRequest));
+  expected.replace(12, 4, "\x01\x02\x03\x04", 4);
+  ASSERT_EQ(expected, gathered(gather));
+  ASSERT_EQ(0, memcmp(kGetRequest, input(0), sizeof(kGetRequest)));
+}
+
+TEST_F(MemcachedSerializingTest, ForwardSkipsUnparsedCase) {
+  auto command = parse(kGetRequest, sizeof(kGetRequest));
+  command->vbucket_id = 0x0102;
+
+  struct iovec iov[8];
+  char scratch[16];
+  dr::serializing::GatherList gather(iov, 8, scratch, sizeof(scratch));
+  uint32_t fields =
+      memcached::MemcachedCommandSerializer::PatchFields::vbucket_id |
+      memcached::MemcachedCommandSerializer::PatchFields::status;
+  auto res =
+      serializer_.forward(input(0), sizeof(kGetRequest),
+                          reinterpret_cast<char*>(command), fields, &gather);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+
+  ASSERT_EQ(3u, gather.count());
+  std::string expected(kGetRequest, sizeof(kGetRequest));
+  expected[6] = '\x01';
+  expected[7] = '\x02';
+  ASSERT_EQ(expected, gathered(gather));
+}
+
+TEST_F(MemcachedSerializingTest, BuilderMatchesSerialize) {
+  auto command = parse(kSetRequest, sizeof(kSetRequest));
+  state_.reset();
+  size_t serialized_len;
+  auto res = serializer_.serialize(reinterpret_cast<char*>(command),
+                                   out_buf_.data(), out_buf_.data() + kBufSize,
+                                   &state_, &serialized_len);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+
+  char built[128];
+  size_t built_len;
+  memcached::MemcachedCommandBuilder builder(built, built + sizeof(built));
+  res = builder.magic_code(memcached::MemcachedMagicCode::REQUEST)
+            .opcode(memcached::MemcachedOpCode::SET)
+            .__anon1(kZeros)
+            .vbucket_id(0)
+            .opaque(kZeros)
+            .cas(kZeros)
+            .extras("\xde\xad\xbe\xef\x00\x00\x0e\x10", 8)
+            .key("Hello", 5)
+            .value("World", 5)
+            .finish(&built_len);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+  ASSERT_EQ(serialized_len, built_len);
+  ASSERT_EQ(0, memcmp(out_buf_.data(), built, built_len));
+
+  // key_len, extras_len and total_len were backpatched by finish()
+  ASSERT_EQ(0, memcmp(kSetRequest, built, sizeof(kSetRequest)));
+  ASSERT_EQ('\x05', built[3]);
+  ASSERT_EQ('\x08', built[4]);
+  ASSERT_EQ('\x12', built[11]);
+}
+
+TEST_F(MemcachedSerializingTest, BuilderResponseCase) {
+  char built[128];
+  size_t built_len;
+  memcached::MemcachedCommandBuilder builder(built, built + sizeof(built));
+  auto res = builder.magic_code(memcached::MemcachedMagicCode::RESPONSE)
+                 .opcode(memcached::MemcachedOpCode::GET)
+                 .__anon1(kZeros)
+                 .status(memcached::MemcachedResponseStatus::NO_ERROR)
+                 .opaque(kZeros)
+                 .cas(kCas1)
+                 .extras("\xde\xad\xbe\xef", 4)
+                 .value("World", 5)
+                 .finish(&built_len);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+  ASSERT_EQ(sizeof(kGetResponse), built_len);
+  ASSERT_EQ(0, memcmp(kGetResponse, built, built_len));
+
+  auto response = parse(built, built_len);
+  ASSERT_EQ(memcached::MemcachedMagicCode::RESPONSE, response->magic_code);
+  ASSERT_EQ(memcached::MemcachedResponseStatus::NO_ERROR, response->status);
+  ASSERT_EQ(5u, response->value.len_);
+}
+
+TEST_F(MemcachedSerializingTest, BuilderStreamsValueInChunks) {
+  char built[128];
+  size_t built_len;
+  memcached::MemcachedCommandBuilder builder(built, built + sizeof(built));
+  builder.magic_code(memcached::MemcachedMagicCode::REQUEST)
+      .opcode(memcached::MemcachedOpCode::SET)
+      .__anon1(kZeros)
+      .vbucket_id(0)
+      .opaque(kZeros)
+      .cas(kZeros)
+      .extras("\xde\xad\xbe\xef\x00\x00\x0e\x10", 8)
+      .key("Hel", 3)
+      .key("lo", 2);
+  builder.value("W", 1);
+  builder.value("or", 2);
+  builder.value("ld", 2);
+  auto res = builder.finish(&built_len);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+  ASSERT_EQ(sizeof(kSetRequest), built_len);
+  ASSERT_EQ(0, memcmp(kSetRequest, built, built_len));
+}
+
+TEST_F(MemcachedSerializingTest, BuilderBufferFull) {
+  char built[sizeof(kSetRequest) - 1];
+  size_t built_len;
+  memcached::MemcachedCommandBuilder builder(built, built + sizeof(built));
+  auto res = builder.magic_code(memcached::MemcachedMagicCode::REQUEST)
+                 .opcode(memcached::MemcachedOpCode::SET)
+                 .__anon1(kZeros)
+                 .vbucket_id(0)
+                 .opaque(kZeros)
+                 .cas(kZeros)
+                 .extras("\xde\xad\xbe\xef\x00\x00\x0e\x10", 8)
+                 .key("Hello", 5)
+                 .value("World", 5)
+                 .finish(&built_len);
+  ASSERT_EQ(dr::serializing::SerializeResult::OUT_BUF_FULL, res);
+}
+
+TEST_F(MemcachedSerializingTest, SerializedSize) {
+  auto request = parse(kGetRequest, sizeof(kGetRequest));
+  auto response = parse(kGetResponse, sizeof(kGetResponse));
+  auto set = parse(kSetRequest, sizeof(kSetRequest));
+  ASSERT_EQ(sizeof(kGetRequest),
+            memcached::MemcachedCommandSerializer::serializedSize(request));
+  ASSERT_EQ(sizeof(kGetResponse),
+            memcached::MemcachedCommandSerializer::serializedSize(response));
+  ASSERT_EQ(sizeof(kSetRequest),
+            memcached::MemcachedCommandSerializer::serializedSize(set));
+}
+
+TEST_F(MemcachedSerializingTest, SerializeBatch) {
+  char* units[] = {
+      reinterpret_cast<char*>(parse(kGetRequest, sizeof(kGetRequest))),
+      reinterpret_cast<char*>(parse(kGetResponse, sizeof(kGetResponse))),
+      reinterpret_cast<char*>(parse(kSetRequest, sizeof(kSetRequest)))};
+  std::string expected(kGetRequest, sizeof(kGetRequest));
+  expected.append(kGetResponse, sizeof(kGetResponse));
+  expected.append(kSetRequest, sizeof(kSetRequest));
+
+  state_.reset();
+  size_t bytes_written;
+  size_t units_written;
+  auto res = serializer_.serializeBatch(
+      units, 3, out_buf_.data(), out_buf_.data() + kBufSize, &state_,
+      &bytes_written, &units_written);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+  ASSERT_EQ(3u, units_written);
+  ASSERT_EQ(expected, std::string(out_buf_.data(), bytes_written));
+}
+
+TEST_F(MemcachedSerializingTest, SerializeBatchBufferFull) {
+  char* units[] = {
+      reinterpret_cast<char*>(parse(kGetRequest, sizeof(kGetRequest))),
+      reinterpret_cast<char*>(parse(kGetResponse, sizeof(kGetResponse))),
+      reinterpret_cast<char*>(parse(kSetRequest, sizeof(kSetRequest)))};
+
+  // room for the first two units and part of the third
+  size_t len = sizeof(kGetRequest) + sizeof(kGetResponse) + 10;
+  state_.reset();
+  size_t bytes_written;
+  size_t units_written;
+  auto res = serializer_.serializeBatch(units, 3, out_buf_.data(),
+                                        out_buf_.data() + len, &state_,
+                                        &bytes_written, &units_written);
+  ASSERT_EQ(dr::serializing::SerializeResult::OUT_BUF_FULL, res);
+  ASSERT_EQ(2u, units_written);
+  ASSERT_EQ(sizeof(kGetRequest) + sizeof(kGetResponse), bytes_written);
+  ASSERT_EQ(0, memcmp(kGetResponse, out_buf_.data() + sizeof(kGetRequest),
+                      sizeof(kGetResponse)));
+
+  // the rest of the batch continues with the remaining units
+  state_.reset();
+  res = serializer_.serializeBatch(units + units_written, 3 - units_written,
+                                   out_buf_.data(), out_buf_.data() + kBufSize,
+                                   &state_, &bytes_written, &units_written);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+  ASSERT_EQ(1u, units_written);
+  ASSERT_EQ(std::string(kSetRequest, sizeof(kSetRequest)),
+            std::string(out_buf_.data(), bytes_written));
+}
+
+TEST_F(MemcachedSerializingTest, SerializeBatchInvalidUnit) {
+  auto request = parse(kGetRequest, sizeof(kGetRequest));
+  auto invalid = parse(kGetRequest, sizeof(kGetRequest));
+  invalid->magic_code = memcached::MemcachedMagicCode::UNDEF;
+  char* units[] = {reinterpret_cast<char*>(request),
+                   reinterpret_cast<char*>(invalid),
+                   reinterpret_cast<char*>(request)};
+
+  state_.reset();
+  size_t bytes_written;
+  size_t units_written;
+  auto res = serializer_.serializeBatch(
+      units, 3, out_buf_.data(), out_buf_.data() + kBufSize, &state_,
+      &bytes_written, &units_written);
+  ASSERT_EQ(dr::serializing::SerializeResult::INVALID_UNIT, res);
+  ASSERT_EQ(1u, units_written);
+  ASSERT_EQ(sizeof(kGetRequest), bytes_written);
+}
+
+TEST_F(MemcachedSerializingTest, SerializeTemplate) {
+  auto response = parse(kGetResponse, sizeof(kGetResponse));
+  char tmpl_buf[64];
+  dr::serializing::WireTemplate tmpl(tmpl_buf, sizeof(tmpl_buf));
+  uint32_t fields =
+      memcached::MemcachedCommandSerializer::TemplateFields::opaque |
+      memcached::MemcachedCommandSerializer::TemplateFields::cas;
+  auto res = tmpl.record(&serializer_, reinterpret_cast<char*>(response),
+                         fields, &state_);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+  ASSERT_EQ(sizeof(kGetResponse), tmpl.size());
+
+  memcpy(response->opaque.data_, "\x01\x02\x03\x04", 4);
+  memcpy(response->cas.data_, "\x00\x00\x00\x00\x00\x00\x00\x02", 8);
+  response->status = memcached::MemcachedResponseStatus::BUSY;
+  size_t bytes_written;
+  res = serializer_.serializeTemplate(reinterpret_cast<char*>(response), tmpl,
+                                      out_buf_.data(),
+                                      out_buf_.data() + kBufSize,
+                                      &bytes_written);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+
+  // only opaque and cas vary, status is copied from the template
+  std::string expected(kGetResponse, sizeof(kGetResponse));
+  expected.replace(12, 4, "\x01\x02\x03\x04", 4);
+  expected[23] = '\x02';
+  ASSERT_EQ(expected, std::string(out_buf_.data(), bytes_written));
+
+  res = serializer_.serializeTemplate(reinterpret_cast<char*>(response), tmpl,
+                                      out_buf_.data(), out_buf_.data() + 10,
+                                      &bytes_written);
+  ASSERT_EQ(dr::serializing::SerializeResult::OUT_BUF_FULL, res);
+}
+
+TEST_F(MemcachedSerializingTest, SerializeGather) {
+  auto command = parse(kSetRequest, sizeof(kSetRequest));
+  struct iovec iov[8];
+  char scratch[64];
+  dr::serializing::GatherList gather(iov, 8, scratch, sizeof(scratch), 5);
+  state_.reset();
+  auto res = serializer_.serializeGather(reinterpret_cast<char*>(command),
+                                         &gather, &state_);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, res);
+  ASSERT_EQ(std::string(kSetRequest, sizeof(kSetRequest)), gathered(gather));
+
+  // extras, key and value are referenced, the header is copied
+  ASSERT_EQ(4u, gather.count());
+  ASSERT_EQ(scratch, gather.iov()[0].iov_base);
+  ASSERT_EQ(24u, gather.iov()[0].iov_len);
+  ASSERT_EQ(command->extras.data_, gather.iov()[1].iov_base);
+  ASSERT_EQ(command->key.data_, gather.iov()[2].iov_base);
+  ASSERT_EQ(command->value.data_, gather.iov()[3].iov_base);
+}
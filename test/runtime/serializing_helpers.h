@@ -0,0 +1,68 @@
+/*
+ * serializing_helpers.h
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TEST_RUNTIME_SERIALIZING_HELPERS_H_
+#define TEST_RUNTIME_SERIALIZING_HELPERS_H_
+
+#include <sys/uio.h>
+#include <cstring>
+#include <string>
+
+#include "runtime/parsing/parser_state.h"
+#include "runtime/serializing/gather_list.h"
+#include "runtime/serializing/serialize_result.h"
+
+namespace diffingo {
+namespace test {
+
+// serializes a unit consisting of a NUL-terminated string
+struct StringSerializer {
+  runtime::serializing::SerializeResult serialize(
+      char* unit, char* out_buf_start, char* out_buf_end,
+      runtime::parsing::ParserState*, size_t* bytes_written) {
+    size_t len = strlen(unit);
+    if (static_cast<size_t>(out_buf_end - out_buf_start) < len)
+      return runtime::serializing::SerializeResult::OUT_BUF_FULL;
+    memcpy(out_buf_start, unit, len);
+    *bytes_written = len;
+    return runtime::serializing::SerializeResult::DONE;
+  }
+};
+
+// concatenates the bytes referenced by a gather list
+inline std::string join(const runtime::serializing::GatherList& gather) {
+  std::string out;
+  for (size_t i = 0; i < gather.count(); ++i) {
+    out.append(static_cast<const char*>(gather.iov()[i].iov_base),
+               gather.iov()[i].iov_len);
+  }
+  return out;
+}
+
+}  // namespace test
+}  // namespace diffingo
+
+#endif  // TEST_RUNTIME_SERIALIZING_HELPERS_H_
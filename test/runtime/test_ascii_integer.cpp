@@ -0,0 +1,218 @@
+/*
+ * test_ascii_integer.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <stddef.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "runtime/parsing/parse_result.h"
+#include "runtime/serializing/serialize_result.h"
+#include "runtime/transform/ascii_integer.h"
+
+namespace dr = diffingo::runtime;
+
+namespace {
+
+template <typename Transform, typename T>
+dr::parsing::ParseResult decode(std::string in, T* value, size_t* consumed) {
+  char* start = &in[0];
+  char* pos = start;
+  auto res = Transform::decode(&pos, start + in.size(),
+                               reinterpret_cast<char*>(value));
+  *consumed = pos - start;
+  return res;
+}
+
+template <typename Transform, typename T>
+std::string encode(T value) {
+  char out_buf[32];
+  char* pos = out_buf;
+  auto res = Transform::encode(reinterpret_cast<char*>(&value), &pos,
+                               out_buf + sizeof(out_buf));
+  EXPECT_EQ(dr::serializing::SerializeResult::DONE, res);
+  EXPECT_EQ(static_cast<size_t>(pos - out_buf),
+            Transform::encodedLength(reinterpret_cast<char*>(&value)));
+  return std::string(out_buf, pos - out_buf);
+}
+
+}  // namespace
+
+TEST(AsciiIntegerTest, DecodeDecimal) {
+  uint64_t value;
+  size_t consumed;
+
+  for (std::string num : {"0", "7", "42", "1234567", "12345678", "123456789",
+                          "00000000000000000001", "18446744073709551615"}) {
+    auto res = decode<dr::transform::stringEncodedUint64>(num + "\r\n", &value,
+                                                          &consumed);
+    ASSERT_EQ(dr::parsing::ParseResult::DONE, res) << num;
+    ASSERT_EQ(num.size(), consumed) << num;
+    ASSERT_EQ(std::stoull(num), value) << num;
+  }
+}
+
+TEST(AsciiIntegerTest, DecodeDecimalInvalid) {
+  uint64_t value;
+  uint32_t value32;
+  size_t consumed;
+
+  ASSERT_EQ(dr::parsing::ParseResult::INVALID_INPUT,
+            decode<dr::transform::stringEncodedUint64>("x123", &value,
+                                                       &consumed));
+  ASSERT_EQ(dr::parsing::ParseResult::INVALID_INPUT,
+            decode<dr::transform::stringEncodedUint64>(
+                "18446744073709551616 ", &value, &consumed));
+  ASSERT_EQ(dr::parsing::ParseResult::INVALID_INPUT,
+            decode<dr::transform::stringEncodedUint32>("4294967296 ", &value32,
+                                                       &consumed));
+  ASSERT_EQ(dr::parsing::ParseResult::DONE,
+            decode<dr::transform::stringEncodedUint32>("4294967295 ", &value32,
+                                                       &consumed));
+  ASSERT_EQ(4294967295u, value32);
+}
+
+TEST(AsciiIntegerTest, DecodeHex) {
+  uint64_t value;
+  size_t consumed;
+
+  for (std::string num : {"0", "f", "1A", "deadBEEF", "123456789abcdef",
+                          "ffffffffffffffff"}) {
+    auto res = decode<dr::transform::hexStringEncodedUint64>(num + ";ext\r\n",
+                                                             &value, &consumed);
+    ASSERT_EQ(dr::parsing::ParseResult::DONE, res) << num;
+    ASSERT_EQ(num.size(), consumed) << num;
+    ASSERT_EQ(std::stoull(num, nullptr, 16), value) << num;
+  }
+
+  ASSERT_EQ(dr::parsing::ParseResult::INVALID_INPUT,
+            decode<dr::transform::hexStringEncodedUint64>(
+                "10000000000000000\r\n", &value, &consumed));
+}
+
+TEST(AsciiIntegerTest, DecodeSplitAcrossReads) {
+  std::string in = "Content-Length: 1234567890123\r\n";
+  char* start = &in[16];
+  char* pos = start;
+  uint64_t value = 0;
+
+  // every prefix that ends within the digits needs more data
+  for (size_t len = 0; len <= 13; len++) {
+    auto res = dr::transform::stringEncodedUint64::decode(
+        &pos, start + len, reinterpret_cast<char*>(&value));
+    ASSERT_EQ(dr::parsing::ParseResult::OUT_OF_DATA, res);
+    ASSERT_EQ(start, pos);
+  }
+
+  auto res = dr::transform::stringEncodedUint64::decode(
+      &pos, start + 14, reinterpret_cast<char*>(&value));
+  ASSERT_EQ(dr::parsing::ParseResult::DONE, res);
+  ASSERT_EQ(start + 13, pos);
+  ASSERT_EQ(1234567890123u, value);
+}
+
+TEST(AsciiIntegerTest, Encode) {
+  ASSERT_EQ("0", (encode<dr::transform::stringEncodedUint32, uint32_t>(0)));
+  ASSERT_EQ("9", (encode<dr::transform::stringEncodedUint32, uint32_t>(9)));
+  ASSERT_EQ("200",
+            (encode<dr::transform::stringEncodedUint32, uint32_t>(200)));
+  ASSERT_EQ("4294967295", (encode<dr::transform::stringEncodedUint32,
+                                  uint32_t>(4294967295u)));
+  ASSERT_EQ("18446744073709551615",
+            (encode<dr::transform::stringEncodedUint64, uint64_t>(
+                18446744073709551615ull)));
+  ASSERT_EQ("0", (encode<dr::transform::hexStringEncodedUint64, uint64_t>(0)));
+  ASSERT_EQ("1a2b",
+            (encode<dr::transform::hexStringEncodedUint64, uint64_t>(0x1a2b)));
+
+  // output buffer too small: nothing is written
+  uint64_t value = 123456;
+  char out_buf[4];
+  char* pos = out_buf;
+  ASSERT_EQ(dr::serializing::SerializeResult::OUT_BUF_FULL,
+            dr::transform::stringEncodedUint64::encode(
+                reinterpret_cast<char*>(&value), &pos, out_buf + 4));
+  ASSERT_EQ(out_buf, pos);
+}
+
+TEST(AsciiIntegerTest, EncodedLength) {
+  uint64_t value = 1;
+  for (size_t digits = 1; digits <= 20; ++digits, value *= 10) {
+    ASSERT_EQ(digits, dr::transform::ascii::decimalLength(value));
+    if (digits < 20) {
+      ASSERT_EQ(digits, dr::transform::ascii::decimalLength(value * 5));
+      ASSERT_EQ(digits, dr::transform::ascii::decimalLength(value * 10 - 1));
+    }
+  }
+  ASSERT_EQ(20u, dr::transform::ascii::decimalLength(~uint64_t(0)));
+  ASSERT_EQ(1u, dr::transform::ascii::hexLength(0xf));
+  ASSERT_EQ(2u, dr::transform::ascii::hexLength(0x10));
+  ASSERT_EQ(16u, dr::transform::ascii::hexLength(~uint64_t(0)));
+}
+
+TEST(AsciiIntegerTest, DecodeBytes) {
+  std::string in = "1234567890123";
+  dr::unit::var_bytes bytes;
+  bytes.len_ = in.size();
+  bytes.data_ = &in[0];
+  uint64_t value = 0;
+
+  // the value is complete, so digits up to its end are not out of data
+  ASSERT_EQ(dr::parsing::ParseResult::DONE,
+            dr::transform::stringEncodedUint64::decodeBytes(
+                bytes, reinterpret_cast<char*>(&value)));
+  ASSERT_EQ(1234567890123u, value);
+
+  bytes.len_ = 0;
+  ASSERT_EQ(dr::parsing::ParseResult::INVALID_INPUT,
+            dr::transform::stringEncodedUint64::decodeBytes(
+                bytes, reinterpret_cast<char*>(&value)));
+
+  // the whole value needs to be a number
+  in = "123 ";
+  bytes.len_ = in.size();
+  bytes.data_ = &in[0];
+  value = 0;
+  ASSERT_EQ(dr::parsing::ParseResult::INVALID_INPUT,
+            dr::transform::stringEncodedUint64::decodeBytes(
+                bytes, reinterpret_cast<char*>(&value)));
+  ASSERT_EQ(0u, value);
+  in = "12ab";
+  bytes.len_ = in.size();
+  bytes.data_ = &in[0];
+  ASSERT_EQ(dr::parsing::ParseResult::DONE,
+            dr::transform::hexStringEncodedUint64::decodeBytes(
+                bytes, reinterpret_cast<char*>(&value)));
+  ASSERT_EQ(0x12abu, value);
+  in = "12abx";
+  bytes.len_ = in.size();
+  bytes.data_ = &in[0];
+  ASSERT_EQ(dr::parsing::ParseResult::INVALID_INPUT,
+            dr::transform::hexStringEncodedUint64::decodeBytes(
+                bytes, reinterpret_cast<char*>(&value)));
+}
@@ -0,0 +1,169 @@
+/*
+ * test_buffer_pool.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <new>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "runtime/parsing/parse_context.h"
+#include "runtime/unit/block_allocator.h"
+#include "runtime/unit/buffer_pool.h"
+
+namespace dr = diffingo::runtime;
+
+TEST(BufferPoolTest, RecyclesBuffers) {
+  dr::unit::BufferPool pool(100, 4);
+  ASSERT_EQ(128u, pool.buffer_size());
+
+  std::set<char*> buffers;
+  for (int i = 0; i < 4; ++i) buffers.insert(pool.acquire());
+  ASSERT_EQ(4u, buffers.size());
+  ASSERT_EQ(nullptr, pool.acquire());
+
+  char* buffer = *buffers.begin();
+  pool.release(buffer);
+  ASSERT_EQ(buffer, pool.acquire());
+}
+
+TEST(BufferPoolTest, SharedBetweenThreads) {
+  const int kThreads = 4;
+  dr::unit::BufferPool pool(64, 2 * kThreads);
+
+  // each thread holds up to two buffers at a time and marks them as its own
+  std::atomic<bool> failed(false);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&pool, &failed, t]() {
+      for (int i = 0; i < 10000; ++i) {
+        char* a = pool.acquire();
+        char* b = pool.acquire();
+        if (!a || !b || a == b) {
+          failed = true;
+          return;
+        }
+        a[0] = b[0] = static_cast<char>(t);
+        std::this_thread::yield();
+        if (a[0] != t || b[0] != t) failed = true;
+        // release in different threads' order to mix the free list
+        pool.release(i % 2 ? a : b);
+        pool.release(i % 2 ? b : a);
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  ASSERT_FALSE(failed);
+
+  // all buffers were returned when the threads exited
+  std::set<char*> buffers;
+  for (int i = 0; i < 2 * kThreads; ++i) buffers.insert(pool.acquire());
+  ASSERT_EQ(static_cast<size_t>(2 * kThreads), buffers.size());
+  ASSERT_EQ(0u, buffers.count(nullptr));
+}
+
+TEST(BufferPoolTest, DestroyedPoolWhileCachedByOtherThread) {
+  // both pools live at the same address
+  alignas(dr::unit::BufferPool) char storage[sizeof(dr::unit::BufferPool)];
+  auto pool = new (storage) dr::unit::BufferPool(64, 2);
+
+  std::promise<void> cached, replaced, acquired, done;
+  char* held = nullptr;
+  std::thread worker([&]() {
+    pool->release(pool->acquire());  // cached by the worker
+    cached.set_value();
+    replaced.get_future().wait();
+    held = pool->acquire();
+    acquired.set_value();
+    done.get_future().wait();
+    pool->release(held);
+  });
+
+  cached.get_future().wait();
+  pool->~BufferPool();
+  pool = new (storage) dr::unit::BufferPool(64, 2);
+  replaced.set_value();
+  acquired.get_future().wait();
+
+  // the worker's stale cache entry didn't hand out a buffer of the new pool
+  char* other = pool->acquire();
+  EXPECT_NE(nullptr, held);
+  EXPECT_NE(nullptr, other);
+  EXPECT_NE(held, other);
+  EXPECT_EQ(nullptr, pool->acquire());
+  pool->release(other);
+
+  done.set_value();
+  worker.join();
+
+  // only the new pool's buffer was returned when the worker exited
+  std::set<char*> buffers;
+  for (int i = 0; i < 2; ++i) buffers.insert(pool->acquire());
+  ASSERT_EQ(2u, buffers.size());
+  ASSERT_EQ(0u, buffers.count(nullptr));
+  ASSERT_EQ(nullptr, pool->acquire());
+  pool->~BufferPool();
+}
+
+TEST(BufferPoolTest, IdleParseContextReleasesBuffers) {
+  dr::unit::BufferPool area_pool(1024, 1);
+  dr::unit::BufferPool stack_pool(256, 1);
+  dr::parsing::ParseContext first(&area_pool, &stack_pool);
+  dr::parsing::ParseContext second(&area_pool, &stack_pool);
+
+  ASSERT_TRUE(first.acquire());
+  ASSERT_EQ(1024u - sizeof(dr::unit::UnitArea), first.area()->size());
+  ASSERT_FALSE(second.acquire());
+
+  first.release();
+  ASSERT_FALSE(first.active());
+  ASSERT_TRUE(second.acquire());
+}
+
+TEST(BlockAllocatorTest, AllocatesHugePageAlignedBlocks) {
+  dr::unit::BlockAllocator::Options options;
+  options.prefault = true;
+  dr::unit::BlockAllocator allocator(options);
+
+  // falls back to regular pages if no huge pages are available
+  size_t size = 2 * dr::unit::BlockAllocator::kHugePageSize + 1;
+  char* block = allocator.allocate(size);
+  ASSERT_NE(nullptr, block);
+  ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(block) %
+                    dr::unit::BlockAllocator::kHugePageSize);
+  memset(block, 0xff, size);
+  allocator.deallocate(block, size);
+
+  // small blocks use regular pages
+  block = allocator.allocate(100);
+  ASSERT_NE(nullptr, block);
+  memset(block, 0xff, 100);
+  allocator.deallocate(block, 100);
+}
@@ -0,0 +1,63 @@
+/*
+ * test_copy.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <vector>
+
+#include "runtime/unit/copy.h"
+
+namespace dr = diffingo::runtime;
+
+namespace {
+
+void checkCopy(size_t len, size_t offset) {
+  std::vector<char> src(len + 64), dest(len + 64, 0);
+  for (size_t i = 0; i < src.size(); ++i) src[i] = static_cast<char>(i * 7);
+
+  dr::unit::copyMemory(&dest[offset], &src[offset / 2], len);
+  ASSERT_EQ(0, memcmp(&dest[offset], &src[offset / 2], len)) << len;
+  // nothing outside of the destination range is written
+  for (size_t i = 0; i < offset; ++i) ASSERT_EQ(0, dest[i]);
+  for (size_t i = offset + len; i < dest.size(); ++i) ASSERT_EQ(0, dest[i]);
+}
+
+}  // namespace
+
+TEST(CopyTest, CopiesAllSizes) {
+  for (size_t len = 0; len <= 300; ++len) {
+    for (size_t offset : {0u, 1u, 7u, 16u}) checkCopy(len, offset);
+  }
+}
+
+TEST(CopyTest, CopiesLargeValuesNonTemporal) {
+  size_t threshold = dr::unit::nonTemporalCopyThreshold();
+  dr::unit::nonTemporalCopyThreshold() = 1024;
+  for (size_t len : {1024u, 1025u, 4096u + 63u, 100000u}) {
+    for (size_t offset : {0u, 3u, 16u}) checkCopy(len, offset);
+  }
+  dr::unit::nonTemporalCopyThreshold() = threshold;
+}
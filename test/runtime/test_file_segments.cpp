@@ -0,0 +1,69 @@
+/*
+ * test_file_segments.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cstdio>
+#include <string>
+
+#include "runtime/serializing/file_segments.h"
+#include "runtime/unit/data_type.h"
+
+namespace dr = diffingo::runtime;
+
+TEST(FileSegmentsTest, SendToPipe) {
+  FILE* file = tmpfile();
+  ASSERT_NE(nullptr, file);
+  ASSERT_EQ(11u, fwrite("xxhelloyyyy", 1, 11, file));
+  fflush(file);
+
+  dr::serializing::FileSegments::Segment storage[2];
+  dr::serializing::FileSegments segments(storage, 2);
+  dr::unit::file_range hello{5, fileno(file), 2, nullptr};
+  dr::unit::file_range empty{0, fileno(file), 0, nullptr};
+  ASSERT_TRUE(segments.add(2, hello));
+  ASSERT_TRUE(segments.add(4, empty));  // empty ranges are skipped
+  ASSERT_TRUE(segments.add(4, hello));
+  EXPECT_FALSE(segments.add(4, hello));
+  EXPECT_EQ(2u, segments.count());
+  EXPECT_EQ(10u, segments.length());
+
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  const char buf[] = "ABCDEF";
+  dr::serializing::FileSender sender(buf, 6, segments);
+  ASSERT_EQ(1, sender.send(fds[1]));
+  close(fds[1]);
+
+  std::string out;
+  char chunk[64];
+  ssize_t n;
+  while ((n = read(fds[0], chunk, sizeof(chunk))) > 0)
+    out.append(chunk, static_cast<size_t>(n));
+  close(fds[0]);
+  fclose(file);
+  EXPECT_EQ("ABhelloCDhelloEF", out);
+}
@@ -0,0 +1,84 @@
+/*
+ * test_gather_list.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <sys/uio.h>
+#include <cstring>
+#include <string>
+
+#include "runtime/serializing/gather_list.h"
+#include "runtime/serializing/util.h"
+#include "serializing_helpers.h"
+
+namespace dr = diffingo::runtime;
+
+TEST(GatherListTest, ReferencesLargeFields) {
+  struct iovec iov[4];
+  char scratch[64];
+  char value[] = "0123456789abcdef";
+  dr::serializing::GatherList gather(iov, 4, scratch, sizeof(scratch), 8);
+
+  char* pos = gather.scratchStart();
+  char* end = gather.scratchEnd();
+  char header[] = "hdr";
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE,
+            dr::serializing::util::gatherBytes(header, 3, &gather, &pos, end));
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE,
+            dr::serializing::util::gatherBytes(value, 16, &gather, &pos, end));
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE,
+            dr::serializing::util::gatherBytes(header, 2, &gather, &pos, end));
+  ASSERT_TRUE(gather.finish(pos));
+
+  ASSERT_EQ(3u, gather.count());
+  // the value isn't copied
+  EXPECT_EQ(value, gather.iov()[1].iov_base);
+  EXPECT_EQ(21u, gather.length());
+  EXPECT_EQ("hdr0123456789abcdefhd", diffingo::test::join(gather));
+}
+
+TEST(GatherListTest, MergesContiguousEntries) {
+  struct iovec iov[2];
+  char scratch[16];
+  char data[32] = {0};
+  dr::serializing::GatherList gather(iov, 2, scratch, sizeof(scratch), 8);
+
+  char* pos = gather.scratchStart();
+  ASSERT_TRUE(gather.addReference(pos, data, 8));
+  ASSERT_TRUE(gather.addReference(pos, data + 8, 8));
+  ASSERT_EQ(1u, gather.count());
+  EXPECT_EQ(16u, gather.iov()[0].iov_len);
+
+  // scratch bytes and a reference need two more entries
+  *pos++ = 'x';
+  EXPECT_FALSE(gather.addReference(pos, data, 8));
+  ASSERT_TRUE(gather.finish(pos));
+  EXPECT_EQ(2u, gather.count());
+  EXPECT_EQ(17u, gather.length());
+
+  gather.clear();
+  EXPECT_EQ(0u, gather.count());
+  EXPECT_EQ(0u, gather.length());
+}
@@ -0,0 +1,97 @@
+/*
+ * test_message_patcher.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <sys/uio.h>
+#include <cstring>
+#include <string>
+
+#include "runtime/serializing/gather_list.h"
+#include "runtime/serializing/message_patcher.h"
+#include "runtime/serializing/serialize_result.h"
+#include "serializing_helpers.h"
+
+namespace dr = diffingo::runtime;
+
+TEST(MessagePatcherTest, PatchesFieldsAndKeepsTail) {
+  struct iovec iov[8];
+  char scratch[16];
+  char msg[] = "GET key 0000 flags 00 tail of the message";
+  size_t msg_len = sizeof(msg) - 1;
+  dr::serializing::GatherList gather(iov, 8, scratch, sizeof(scratch));
+  dr::serializing::MessagePatcher patcher(msg, msg_len, &gather);
+
+  char* pos;
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE,
+            patcher.patch(8, 4, &pos));
+  memcpy(pos, "1234", 4);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE,
+            patcher.patch(19, 2, &pos));
+  memcpy(pos, "42", 2);
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE, patcher.finish());
+
+  EXPECT_EQ("GET key 1234 flags 42 tail of the message",
+            diffingo::test::join(gather));
+  EXPECT_EQ(msg_len, gather.length());
+  // the unchanged ranges reference the message
+  EXPECT_EQ(msg, gather.iov()[0].iov_base);
+  EXPECT_EQ(msg + 21, gather.iov()[gather.count() - 1].iov_base);
+  // the message itself is left untouched
+  EXPECT_EQ("GET key 0000 flags 00 tail of the message", std::string(msg));
+}
+
+TEST(MessagePatcherTest, RejectsInvalidOffsets) {
+  struct iovec iov[8];
+  char scratch[16];
+  char msg[] = "0123456789";
+  dr::serializing::GatherList gather(iov, 8, scratch, sizeof(scratch));
+  char* pos;
+
+  {
+    // past the end of the message
+    dr::serializing::MessagePatcher patcher(msg, 10, &gather);
+    EXPECT_EQ(dr::serializing::SerializeResult::INVALID_UNIT,
+              patcher.patch(8, 4, &pos));
+    EXPECT_EQ(dr::serializing::SerializeResult::INVALID_UNIT,
+              patcher.patch(~size_t(0), 1, &pos));
+  }
+  {
+    // overlapping an earlier field
+    dr::serializing::MessagePatcher patcher(msg, 10, &gather);
+    ASSERT_EQ(dr::serializing::SerializeResult::DONE,
+              patcher.patch(2, 4, &pos));
+    EXPECT_EQ(dr::serializing::SerializeResult::INVALID_UNIT,
+              patcher.patch(5, 1, &pos));
+  }
+  {
+    // more patched bytes than fit into the scratch buffer
+    dr::serializing::GatherList small(iov, 8, scratch, 2);
+    dr::serializing::MessagePatcher patcher(msg, 10, &small);
+    EXPECT_EQ(dr::serializing::SerializeResult::OUT_BUF_FULL,
+              patcher.patch(0, 4, &pos));
+  }
+}
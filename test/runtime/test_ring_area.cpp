@@ -0,0 +1,98 @@
+/*
+ * test_ring_area.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <cstdint>
+
+#include "runtime/unit/ring_area.h"
+#include "runtime/unit/unit_area.h"
+
+namespace dr = diffingo::runtime;
+
+namespace {
+
+// commits a unit allocating the given number of bytes, returns generation
+uint64_t commitUnit(dr::unit::RingArea* ring, size_t size) {
+  auto area = ring->begin(size);
+  char* pos;
+  EXPECT_TRUE(area && area->allocate(size, &pos));
+  return ring->commit(area);
+}
+
+}  // namespace
+
+TEST(RingAreaTest, ReleasesInFifoOrder) {
+  alignas(8) char buf[256];
+  dr::unit::RingArea ring(buf, sizeof(buf));
+
+  auto first = commitUnit(&ring, 40);
+  auto second = commitUnit(&ring, 40);
+  auto third = commitUnit(&ring, 40);
+  ASSERT_EQ(3u, ring.count());
+  ASSERT_EQ(buf, reinterpret_cast<char*>(ring.area(first)));
+  ASSERT_EQ(40u, ring.area(second)->allocated());
+
+  ring.releaseOldest();
+  ASSERT_FALSE(ring.live(first));
+  ASSERT_TRUE(ring.live(second));
+
+  ring.releaseUntil(third);
+  ASSERT_TRUE(ring.empty());
+  ASSERT_FALSE(ring.live(third));
+}
+
+TEST(RingAreaTest, WrapsAround) {
+  alignas(8) char buf[256];
+  dr::unit::RingArea ring(buf, sizeof(buf));
+
+  // three 80 byte chunks (incl. UnitArea header) leave 16 bytes at the end
+  auto first = commitUnit(&ring, 80 - sizeof(dr::unit::UnitArea));
+  commitUnit(&ring, 80 - sizeof(dr::unit::UnitArea));
+  auto third = commitUnit(&ring, 80 - sizeof(dr::unit::UnitArea));
+  ASSERT_EQ(nullptr, ring.begin(32));
+
+  // the space of the oldest unit is reused
+  ring.releaseOldest();
+  auto fourth = commitUnit(&ring, 32);
+  ASSERT_EQ(buf, reinterpret_cast<char*>(ring.area(fourth)));
+  ASSERT_EQ(nullptr, ring.begin(64));
+
+  // after releasing the units before the wrap, the ring continues behind
+  // the fourth unit
+  ring.releaseUntil(third);
+  ASSERT_TRUE(ring.live(fourth));
+  ASSERT_FALSE(ring.live(first));
+  auto fifth = commitUnit(&ring, 64);
+  ASSERT_EQ(reinterpret_cast<char*>(ring.area(fourth)) + 48,
+            reinterpret_cast<char*>(ring.area(fifth)));
+
+  // a fixed-size ring is reused indefinitely
+  for (int i = 0; i < 100; ++i) {
+    commitUnit(&ring, 24);
+    ring.releaseOldest();
+  }
+  ASSERT_EQ(2u, ring.count());
+}
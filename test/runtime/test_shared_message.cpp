@@ -0,0 +1,89 @@
+/*
+ * test_shared_message.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <sys/uio.h>
+#include <cstring>
+#include <string>
+
+#include "runtime/parsing/parser_state.h"
+#include "runtime/serializing/gather_list.h"
+#include "runtime/serializing/serialize_result.h"
+#include "runtime/serializing/shared_message.h"
+#include "serializing_helpers.h"
+
+namespace dr = diffingo::runtime;
+
+TEST(SharedMessageTest, GatherPatched) {
+  char stack[64];
+  dr::parsing::ParserState state(stack, sizeof(stack));
+  diffingo::test::StringSerializer serializer;
+  auto msg = dr::serializing::SharedMessage::create(32);
+
+  char unit[] = "HDR:AAAA:BB:payload";
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE,
+            msg->encode(&serializer, unit, &state));
+  ASSERT_EQ(strlen(unit), msg->size());
+
+  ASSERT_TRUE(msg->addSlot(4, 4));
+  EXPECT_FALSE(msg->addSlot(6, 2));  // overlaps
+  ASSERT_TRUE(msg->addSlot(9, 2));
+  EXPECT_FALSE(msg->addSlot(18, 2));  // exceeds the message
+  EXPECT_EQ(6u, msg->patchSize());
+
+  // two destinations share the encoded bytes
+  msg->ref();
+  struct iovec iov[8];
+  char scratch[16];
+  dr::serializing::GatherList gather(iov, 8, scratch, sizeof(scratch));
+  ASSERT_TRUE(msg->gather(&gather, "1111xy"));
+  EXPECT_EQ("HDR:1111:xy:payload", diffingo::test::join(gather));
+  EXPECT_EQ(msg->size(), gather.length());
+  EXPECT_EQ(msg->data(), gather.iov()[0].iov_base);
+  msg->unref();
+
+  ASSERT_TRUE(msg->gather(&gather, "2222zz"));
+  EXPECT_EQ("HDR:2222:zz:payload", diffingo::test::join(gather));
+  msg->unref();
+}
+
+TEST(SharedMessageTest, ScratchFull) {
+  char stack[64];
+  dr::parsing::ParserState state(stack, sizeof(stack));
+  diffingo::test::StringSerializer serializer;
+  auto msg = dr::serializing::SharedMessage::create(8);
+
+  char unit[] = "abcdefgh";
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE,
+            msg->encode(&serializer, unit, &state));
+  ASSERT_TRUE(msg->addSlot(2, 4));
+
+  struct iovec iov[8];
+  char scratch[2];
+  dr::serializing::GatherList gather(iov, 8, scratch, sizeof(scratch));
+  EXPECT_FALSE(msg->gather(&gather, "1234"));
+  msg->unref();
+}
@@ -0,0 +1,226 @@
+/*
+ * test_util.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+
+#include "runtime/parsing/parse_result.h"
+#include "runtime/parsing/util.h"
+#include "runtime/serializing/serialize_result.h"
+#include "runtime/serializing/util.h"
+
+namespace dr = diffingo::runtime;
+
+namespace {
+
+template <size_t N>
+void checkMatchConstant(const char* constant) {
+  std::string in(constant, N);
+  in += "tail";
+  char* pos = &in[0];
+
+  // incomplete input
+  ASSERT_EQ(dr::parsing::ParseResult::OUT_OF_DATA,
+            dr::parsing::util::matchConstant<N>(&pos, pos + N - 1, constant));
+  ASSERT_EQ(&in[0], pos);
+
+  ASSERT_EQ(dr::parsing::ParseResult::DONE,
+            dr::parsing::util::matchConstant<N>(&pos, &in[0] + in.size(),
+                                                constant));
+  ASSERT_EQ(&in[N], pos);
+
+  // mismatch in first and last byte
+  for (size_t i : {static_cast<size_t>(0), N - 1}) {
+    std::string bad(constant, N);
+    bad[i] ^= 0x20;
+    pos = &bad[0];
+    ASSERT_EQ(dr::parsing::ParseResult::INVALID_INPUT,
+              dr::parsing::util::matchConstant<N>(&pos, pos + N, constant));
+    ASSERT_EQ(&bad[0], pos);
+  }
+}
+
+}  // namespace
+
+TEST(ParsingUtilTest, MatchConstant) {
+  checkMatchConstant<1>("\x80");
+  checkMatchConstant<3>("GET");
+  checkMatchConstant<4>("HTTP");
+  checkMatchConstant<7>("HTTP/1.");
+  checkMatchConstant<9>("HTTP/1.1 ");
+  checkMatchConstant<16>("0123456789abcdef");
+  checkMatchConstant<23>("Transfer-Encoding: chun");
+}
+
+TEST(SerializingUtilTest, CopyConstant) {
+  char out_buf[8];
+  char* pos = out_buf;
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE,
+            dr::serializing::util::copyConstant<5>("\r\n\r\n!", &pos,
+                                                   out_buf + 8));
+  ASSERT_EQ(out_buf + 5, pos);
+  ASSERT_EQ(0, memcmp(out_buf, "\r\n\r\n!", 5));
+  ASSERT_EQ(dr::serializing::SerializeResult::OUT_BUF_FULL,
+            dr::serializing::util::copyConstant<5>("\r\n\r\n!", &pos,
+                                                   out_buf + 8));
+  ASSERT_EQ(out_buf + 5, pos);
+}
+
+TEST(SerializingUtilTest, FixedBlockWords) {
+  // memcached-like header: magic, opcode, key_len (big), 3 bytes, 4 bytes
+  // total_len (big) spilling into the second word
+  uint64_t words[2] = {0x81ULL, 0x0ULL};
+  uint64_t bits;
+  bits = dr::serializing::util::wireBits<uint8_t, true>(0x01);
+  words[0] |= bits << 8;
+  bits = dr::serializing::util::wireBits<uint16_t, true>(0x1234);
+  words[0] |= bits << 16;
+  bits = dr::serializing::util::bytesBits<3>("abc");
+  words[0] |= bits << 32;
+  bits = dr::serializing::util::wireBits<int32_t, true>(-2);
+  words[0] |= bits << 56;
+  words[1] |= bits >> 8;
+
+  char out_buf[11];
+  char* pos = out_buf;
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE,
+            (dr::serializing::util::copyConstant<11, false>(
+                reinterpret_cast<const char*>(words), &pos, out_buf + 11)));
+  ASSERT_EQ(out_buf + 11, pos);
+  ASSERT_EQ(0, memcmp(out_buf, "\x81\x01\x12\x34"
+                               "abc\xff\xff\xff\xfe",
+                      11));
+}
+
+TEST(ParsingUtilTest, CopyFixedBytes) {
+  std::string in = "\x01\x02\x03\x04rest";
+  char* pos = &in[0];
+  dr::unit::fixed_bytes<4> opaque;
+  char* dest = reinterpret_cast<char*>(&opaque);
+
+  ASSERT_EQ(dr::parsing::ParseResult::OUT_OF_DATA,
+            dr::parsing::util::copyFixedBytes<4>(&pos, pos + 3, dest));
+  ASSERT_EQ(&in[0], pos);
+  ASSERT_EQ(dr::parsing::ParseResult::DONE,
+            dr::parsing::util::copyFixedBytes<4>(&pos, &in[0] + in.size(),
+                                                 dest));
+  ASSERT_EQ(&in[4], pos);
+  ASSERT_EQ(0, memcmp(opaque.data_, "\x01\x02\x03\x04", 4));
+
+  char out_buf[6];
+  char* out_pos = out_buf;
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE,
+            dr::serializing::util::copyFixedBytes<4>(dest, &out_pos,
+                                                     out_buf + 6));
+  ASSERT_EQ(out_buf + 4, out_pos);
+  ASSERT_EQ(0, memcmp(out_buf, "\x01\x02\x03\x04", 4));
+  ASSERT_EQ(dr::serializing::SerializeResult::OUT_BUF_FULL,
+            dr::serializing::util::copyFixedBytes<4>(dest, &out_pos,
+                                                     out_buf + 6));
+}
+
+TEST(ParsingUtilTest, AllocateCopyInlineBytes) {
+  char area_buf[256];
+  auto area = new (area_buf) dr::unit::UnitArea(sizeof(area_buf));
+  std::string in = "Hello, this key is longer than eight bytes";
+
+  // short values are stored inline
+  dr::unit::inline_string<8> key;
+  key.len_ = 5;
+  char* pos = &in[0];
+  ASSERT_EQ(dr::parsing::ParseResult::DONE,
+            dr::parsing::util::allocateCopyInlineBytes(
+                &pos, &in[0] + in.size(), &key, area));
+  ASSERT_EQ(key.inline_, key.data_);
+  ASSERT_EQ(0, memcmp(key.data_, "Hello", 5));
+  ASSERT_EQ(0u, area->allocated());
+
+  // long values spill to the area
+  key.len_ = in.size();
+  pos = &in[0];
+  ASSERT_EQ(dr::parsing::ParseResult::OUT_OF_DATA,
+            dr::parsing::util::allocateCopyInlineBytes(&pos, &in[4], &key,
+                                                       area));
+  ASSERT_EQ(dr::parsing::ParseResult::DONE,
+            dr::parsing::util::allocateCopyInlineBytes(
+                &pos, &in[0] + in.size(), &key, area));
+  ASSERT_EQ(area->contents(), key.data_);
+  ASSERT_EQ(in, std::string(key.data_, key.len_));
+  ASSERT_EQ(in.size(), area->allocated());
+}
+
+TEST(ParsingUtilTest, CarveCopyBytes) {
+  char area_buf[256];
+  auto area = new (area_buf) dr::unit::UnitArea(sizeof(area_buf));
+  std::string in = "keyvalue";
+
+  // both fields are carved out of a single allocation
+  char* carve_pos;
+  ASSERT_TRUE(area->allocate(in.size(), &carve_pos));
+  dr::unit::var_bytes key{0, nullptr}, value{0, nullptr};
+  char* pos = &in[0];
+  ASSERT_EQ(dr::parsing::ParseResult::DONE,
+            dr::parsing::util::carveCopyBytes(&pos, &in[0] + in.size(),
+                                              &key.data_, 3, &carve_pos));
+  ASSERT_EQ(dr::parsing::ParseResult::OUT_OF_DATA,
+            dr::parsing::util::carveCopyBytes(&pos, &in[4], &value.data_, 5,
+                                              &carve_pos));
+  ASSERT_EQ(dr::parsing::ParseResult::DONE,
+            dr::parsing::util::carveCopyBytes(&pos, &in[0] + in.size(),
+                                              &value.data_, 5, &carve_pos));
+  ASSERT_EQ(area->contents(), key.data_);
+  ASSERT_EQ(area->contents() + 3, value.data_);
+  ASSERT_EQ(area->nextPos(), carve_pos);
+  ASSERT_EQ(0, memcmp(area->contents(), "keyvalue", in.size()));
+}
+
+TEST(ParsingUtilTest, RelativeBytesAreRelocatable) {
+  alignas(8) char area_buf[128];
+  auto area = new (area_buf) dr::unit::UnitArea(sizeof(area_buf));
+  dr::unit::rel_bytes* value;
+  ASSERT_TRUE(area->allocate(&value));
+  ASSERT_EQ(8u, sizeof(*value));
+
+  std::string in = "value";
+  char* pos = &in[0];
+  value->len_ = 5;
+  ASSERT_EQ(dr::parsing::ParseResult::DONE,
+            dr::parsing::util::allocateCopyBytes(
+                &pos, &in[0] + in.size(), &value->data_, value->len_, area));
+  ASSERT_EQ("value", std::string(static_cast<char*>(value->data_), 5));
+
+  // the whole area can be moved with a single copy
+  alignas(8) char copy_buf[128];
+  memcpy(copy_buf, area_buf, sizeof(area_buf));
+  memset(area_buf, 0, sizeof(area_buf));
+  auto copy = reinterpret_cast<dr::unit::rel_bytes*>(
+      copy_buf + (reinterpret_cast<char*>(value) - area_buf));
+  ASSERT_EQ(copy_buf + sizeof(dr::unit::UnitArea) + sizeof(*value),
+            static_cast<char*>(copy->data_));
+  ASSERT_EQ("value", std::string(static_cast<char*>(copy->data_), 5));
+}
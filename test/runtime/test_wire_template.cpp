@@ -0,0 +1,56 @@
+/*
+ * test_wire_template.cpp
+ *
+ * Distributed under the MIT License (MIT).
+ *
+ * Copyright (c) 2015 Eric Seckler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+
+#include "runtime/parsing/parser_state.h"
+#include "runtime/serializing/serialize_result.h"
+#include "runtime/serializing/wire_template.h"
+#include "serializing_helpers.h"
+
+namespace dr = diffingo::runtime;
+
+TEST(WireTemplateTest, Record) {
+  char stack[64];
+  dr::parsing::ParserState state(stack, sizeof(stack));
+  diffingo::test::StringSerializer serializer;
+  char buffer[8];
+  dr::serializing::WireTemplate tmpl(buffer, sizeof(buffer));
+
+  char unit[] = "NOOP";
+  ASSERT_EQ(dr::serializing::SerializeResult::DONE,
+            tmpl.record(&serializer, unit, 0x3, &state));
+  EXPECT_EQ(4u, tmpl.size());
+  EXPECT_EQ(0x3u, tmpl.fields());
+  EXPECT_EQ(0, memcmp(tmpl.data(), "NOOP", 4));
+
+  // a template that doesn't fit is empty
+  char large_unit[] = "too large";
+  ASSERT_EQ(dr::serializing::SerializeResult::OUT_BUF_FULL,
+            tmpl.record(&serializer, large_unit, 0x1, &state));
+  EXPECT_EQ(0u, tmpl.size());
+}